@@ -44,13 +44,19 @@ HEADERS +=  src/repocore.h\
             src/repocoreglobal.h \
             src/assimpwrapper.h \
             src/mongoclientwrapper.h \
+            src/mongoclientpool.h \
+            src/mongoclientasync.h \
+            src/mongobatchwriter.h \
+            src/mongogeometryloader.h \
             src/graph/repo_bounding_box.h \
             src/graph/repo_graph_abstract.h \
             src/graph/repo_graph_history.h \
             src/graph/repo_graph_scene.h \
+            src/graph/repo_scene_decoder.h \
             src/graph/repo_node_abstract.h \
             src/graph/repo_node_camera.h \
             src/graph/repo_node_material.h \
+            src/graph/repo_geometry_loader.h \
             src/graph/repo_node_mesh.h \
             src/graph/repo_node_revision.h \
             src/graph/repo_node_reference.h \
@@ -60,18 +66,24 @@ HEADERS +=  src/repocore.h\
             src/primitives/repo_user.h \
             src/primitives/repo_vertex.h \
             src/primitives/repostreambuffer.h \
+            src/primitives/repothreadpool.h \
+            src/primitives/repobinaryview.h \
+            src/primitives/repofacebuffer.h \
+            src/primitives/repoalignedallocator.h \
+            src/primitives/repovertexattributes.h \
             src/primitives/repoabstractlistener.h \
             src/primitives/repoabstractnotifier.h \
             src/primitives/reposeverity.h \
             src/primitives/repobson.h \
             src/primitives/reporole.h \
             src/conversion/repo_transcoder_bson.h \
+            src/conversion/repo_transcoder_mesh.h \
             src/conversion/repo_transcoder_string.h \
             src/compute/render.h \
 			src/primitives/repoimage.h \
             src/diff/repo3ddiff.h \
-            src/sha256/sha256.h \
             src/compute/repo_pca.h \
+            src/compute/repo_sha256.h \
             src/compute/repo_eigen.h \
             src/compute/repocsv.h \
             src/compute/repographoptimizer.h \
@@ -83,10 +95,15 @@ SOURCES +=  src/repocore.cpp \
             src/repologger.cpp \
             src/assimpwrapper.cpp \
             src/mongoclientwrapper.cpp \
+            src/mongoclientpool.cpp \
+            src/mongoclientasync.cpp \
+            src/mongobatchwriter.cpp \
+            src/mongogeometryloader.cpp \
             src/graph/repo_bounding_box.cpp \
             src/graph/repo_graph_abstract.cpp \
             src/graph/repo_graph_history.cpp \
             src/graph/repo_graph_scene.cpp \
+            src/graph/repo_scene_decoder.cpp \
             src/graph/repo_node_abstract.cpp \
             src/graph/repo_node_camera.cpp \
             src/graph/repo_node_material.cpp \
@@ -99,18 +116,22 @@ SOURCES +=  src/repocore.cpp \
             src/primitives/repo_user.cpp \
             src/primitives/repo_vertex.cpp \
             src/primitives/repostreambuffer.cpp \
+            src/primitives/repothreadpool.cpp \
+            src/primitives/repofacebuffer.cpp \
+            src/primitives/repovertexattributes.cpp \
             src/primitives/repoabstractlistener.cpp \
             src/primitives/repoabstractnotifier.cpp \
             src/primitives/reposeverity.cpp \
             src/primitives/repobson.cpp \
             src/primitives/reporole.cpp \
             src/conversion/repo_transcoder_bson.cpp \
+            src/conversion/repo_transcoder_mesh.cpp \
             src/conversion/repo_transcoder_string.cpp \
             src/compute/render.cpp \
-            src/sha256/sha256.cpp \
 			src/primitives/repoimage.cpp \
                         src/diff/repo3ddiff.cpp \
             src/compute/repo_pca.cpp \
+            src/compute/repo_sha256.cpp \
             src/compute/repo_eigen.cpp \
     src/compute/repocsv.cpp \
     src/compute/repographoptimizer.cpp \
@@ -21,4 +21,6 @@ TEMPLATE = subdirs
 CONFIG += ordered
 
 SUBDIRS += 3drepocore.pro \
-           3drepocli.pro
+           3drepocli.pro \
+           3drepotest.pro \
+           3drepobench.pro
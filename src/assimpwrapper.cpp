@@ -176,6 +176,17 @@ const aiScene* repo::core::AssimpWrapper::getScene()
 	return scene;
 }
 
+aiScene *repo::core::AssimpWrapper::releaseScene()
+{
+	aiScene *orphan = NULL;
+	if (getScene())
+	{
+		orphan = importer.GetOrphanedScene();
+		resetScene();
+	}
+	return orphan;
+}
+
 std::string repo::core::AssimpWrapper::getImportFormats()
 {
     Assimp::Importer importer;
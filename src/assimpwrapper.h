@@ -66,6 +66,14 @@ public :
     //! Returns loaded scene
     const aiScene* getScene();
 
+    /*!
+     * Returns loaded scene prepared as by getScene() and passes its ownership
+     * to the caller, eg to RepoGraphScene(std::unique_ptr<aiScene>, ...), so
+     * that it does not have to stay in memory alongside the converted graph.
+     * No scene is loaded afterwards. Returns NULL if there is no scene.
+     */
+    aiScene *releaseScene();
+
     //! Returns true if scene is loaded, false otherwise.
     bool isSceneLoaded();
 
@@ -1,7 +1,11 @@
 #include "mongoclientwrapper.h"
+#include "mongoclientpool.h"
+#include "mongobatchwriter.h"
+#include "mongogeometryloader.h"
 #include "graph/repo_node_types.h"
 #include "graph/repo_node_revision.h"
 #include "graph/repo_graph_scene.h"
+#include "graph/repo_scene_decoder.h"
 #include "graph/repo_node_texture.h"
 
 #include "compute/render.h"
@@ -24,15 +28,16 @@ const std::string HelpStr("help");
 const std::string CacheStr("cache");
 const std::string DBListStr("dblist");
 const std::string ExportStr("export");
+const std::string TreeStr("tree");
 
 std::string prog_name;
 
 void print_usage()
 {
-	std::cout << prog_name << " <server> <port> <username> <password> [" << HelpStr << "|" << CacheStr << "|" << DBListStr << "|" << ExportStr << "] [db_name] [export_filename]" << std::endl;
+	std::cout << prog_name << " <server> <port> <username> <password> [" << HelpStr << "|" << CacheStr << "|" << DBListStr << "|" << ExportStr << "|" << TreeStr << "] [db_name] [export_filename]" << std::endl;
 }
 
-void getHeadRevision(repo::core::MongoClientWrapper &mongo, std::string dbname, repo::core::RepoGraphScene *& sceneLoader)
+bool getHeadRevision(repo::core::MongoClientWrapper &mongo, std::string dbname, repo::core::RepoGraphScene *& sceneLoader)
 {
 	// Read Head Revision
 	std::vector<mongo::BSONObj> data;
@@ -43,10 +48,54 @@ void getHeadRevision(repo::core::MongoClientWrapper &mongo, std::string dbname,
 
 	std::cout << "Loading full collection .... ";
 	repo::core::RepoCore core;
-	mongo.fetchEntireCollection(dbname, "scene", data);
+	if (!mongo.fetchEntireCollectionParallel(dbname, "scene", data))
+	{
+		std::cout << "failed." << std::endl;
+		return false;
+	}
+	std::cout << "done." << std::endl;
+
+	// Meshes and textures borrow their data from the fetched objects
+	sceneLoader = new repo::core::RepoGraphScene(data, true);
+	return true;
+}
+
+// Reads the head revision without mesh geometry, which is fetched on demand.
+bool getHeadRevisionSkeleton(repo::core::MongoClientWrapper &mongo, std::string dbname, repo::core::RepoGraphScene *& sceneLoader)
+{
+	// Nodes are constructed on worker threads while the documents arrive
+	repo::core::RepoSceneDecoder decoder;
+
+	std::cout << "Loading scene skeleton .... ";
+	bool success = mongo.fetchEntireCollection(dbname, "scene", decoder.getConsumer(),
+		repo::core::MongoClientWrapper::fieldsToExclude(
+			repo::core::RepoNodeMesh::getGeometryFields()));
+	sceneLoader = decoder.finish();
+	if (!success || decoder.getFailedCount() > 0)
+	{
+		std::cout << "failed." << std::endl;
+		delete sceneLoader;
+		sceneLoader = NULL;
+		return false;
+	}
 	std::cout << "done." << std::endl;
 
-	sceneLoader = new repo::core::RepoGraphScene(data);
+	sceneLoader->setGeometryLoader(
+		new repo::core::MongoGeometryLoader(mongo, dbname, "scene"));
+	return true;
+}
+
+void printTree(const repo::core::RepoNodeAbstract *node, unsigned int depth)
+{
+	if (!node)
+		return;
+
+	std::cout << std::string(2 * depth, ' ') << node->getType() << " "
+		<< node->getName() << std::endl;
+
+	std::set<const repo::core::RepoNodeAbstract *> children = node->getChildren();
+	for (std::set<const repo::core::RepoNodeAbstract *>::iterator it = children.begin(); it != children.end(); ++it)
+		printTree(*it, depth + 1);
 }
 
 enum Params
@@ -107,11 +156,13 @@ int main(int argc, char **argv)
 		std::string dbname     = std::string(argv[DBNameParam]);
 		std::string exportname = std::string(argv[ExportNameParam]);
 
-		repo::core::RepoGraphScene *sceneLoader;
-		getHeadRevision(mongo, dbname, sceneLoader);
+		repo::core::RepoGraphScene *sceneLoader = NULL;
+		if (!getHeadRevision(mongo, dbname, sceneLoader))
+			return -1;
 
+		// Geometry is moved mesh by mesh rather than held twice
 		aiScene *scene = new aiScene();
-		sceneLoader->toAssimp(scene);
+		sceneLoader->moveToAssimp(scene);
 
 		std::map<std::string, QImage> nameTextures;
 		std::vector<repo::core::RepoNodeTexture*> textures = sceneLoader->getTextures();
@@ -119,7 +170,7 @@ int main(int argc, char **argv)
 		for(unsigned int i = 0; i < textures.size(); i++)
 		{
 			repo::core::RepoNodeTexture *repoTex = textures[i];
-			const unsigned char* data = (unsigned char*) repoTex->getData();
+			const unsigned char* data = (const unsigned char*) repoTex->getRawData();
 			QImage image = QImage::fromData(data, repoTex->getRawDataSize());
 			nameTextures.insert(std::make_pair(repoTex->getName(), image));
 		}
@@ -146,7 +197,7 @@ int main(int argc, char **argv)
 			for (std::vector<repo::core::RepoNodeTexture *>::const_iterator it = texs.begin(); it != texs.begin(); ++it)
 			{
 				repo::core::RepoNodeTexture* tex = (*it);
-				const unsigned char* data = (unsigned char*) tex->getData();
+				const unsigned char* data = (const unsigned char*) tex->getRawData();
 				QImage image = QImage::fromData(data, tex->getRawDataSize());
 				QString filename = QString::fromStdString(tex->getName());
 
@@ -162,6 +213,21 @@ int main(int argc, char **argv)
 			}
 		}
 
+	} else if (!operation.compare(TreeStr)) {
+		if (argc < (DBNameParam + 1))
+		{
+			print_usage();
+			return -1;
+		}
+
+		std::string dbname = std::string(argv[DBNameParam]);
+		repo::core::RepoGraphScene *sceneLoader = NULL;
+
+		if (!getHeadRevisionSkeleton(mongo, dbname, sceneLoader))
+			return -1;
+		printTree(sceneLoader->getRoot(), 0);
+		delete sceneLoader;
+
 	} else if (!operation.compare(CacheStr)) {
 		if (argc < (DBNameParam + 1))
 		{
@@ -172,17 +238,23 @@ int main(int argc, char **argv)
 		std::string dbname = std::string(argv[DBNameParam]);
 		repo::core::RepoGraphScene *sceneLoader = NULL;
 
-		getHeadRevision(mongo, dbname, sceneLoader);
+		if (!getHeadRevision(mongo, dbname, sceneLoader))
+			return -1;
 		repo::core::Renderer rend(sceneLoader);
 		std::vector<mongo::BSONObj> out;
 		rend.renderToBSONs(out);
 
 		mongo.deleteAllRecords(dbname, "repo.cache");
 
-		for(std::vector<mongo::BSONObj>::iterator it = out.begin(); it != out.end(); ++it)
-		{
-		  mongo.insertRecord(dbname, "repo.cache", (*it));
-		}
+		repo::core::MongoBatchWriter writer(mongo.getConnectionPool(), dbname, "repo.cache");
+		writer.insert(out);
+		if (!writer.flush())
+			std::cout << writer.getFailedBatchesCount() << " batches failed" << std::endl;
+
+		std::cout << "Written " << writer.getDocumentsCount() << " documents in "
+			<< writer.getBatchesCount() << " batches ("
+			<< writer.getDocumentsPerSecond() << " docs/s, "
+			<< writer.getMegabytesPerSecond() << " MB/s)" << std::endl;
 
 	}
 }
@@ -42,11 +42,16 @@ void repo::core::Renderer::renderToBSONs(std::vector<mongo::BSONObj> &out)
         float bboxSizeY = (bbox.getMax()[1] - bbox.getMin()[1]);
         float bboxSizeZ = (bbox.getMax()[2] - bbox.getMin()[2]);
 
-        const std::vector<aiVector3t<float> > * verts = mesh->getVertices();
-
-        if (verts != NULL)
+        // Separate arrays of each coordinate, normal and UV component
+        const RepoVertexAttributes attributes = mesh->getVertexAttributes(
+                    RepoVertexAttributes::getMask(RepoVertexAttributes::POSITION) |
+                    RepoVertexAttributes::getMask(RepoVertexAttributes::NORMAL) |
+                    RepoVertexAttributes::getMask(RepoVertexAttributes::UV_CHANNEL_0));
+        const size_t attr_stride = attributes.getStride();
+
+        if (!attributes.empty())
         {
-            size_t num_verts = verts->size();
+            size_t num_verts = attributes.size();
 
             std::vector<int> vertex_map(num_verts, -1);
             std::vector<int64_t> vertex_quant_idx(num_verts, 0);
@@ -57,64 +62,51 @@ void repo::core::Renderer::renderToBSONs(std::vector<mongo::BSONObj> &out)
             unsigned int idx_buf_ptr = 0;
             unsigned int buf_offset = 0;
 
-            const std::vector<aiVector3t<float> > *uvChannel = mesh->getUVChannel(0);
+            const float *uv[2] = {
+                attributes.getComponent(RepoVertexAttributes::UV_CHANNEL_0, 0),
+                attributes.getComponent(RepoVertexAttributes::UV_CHANNEL_0, 1) };
+            const float *normal[3] = {
+                attributes.getComponent(RepoVertexAttributes::NORMAL, 0),
+                attributes.getComponent(RepoVertexAttributes::NORMAL, 1),
+                attributes.getComponent(RepoVertexAttributes::NORMAL, 2) };
+            const float *position[3] = {
+                attributes.getComponent(RepoVertexAttributes::POSITION, 0),
+                attributes.getComponent(RepoVertexAttributes::POSITION, 1),
+                attributes.getComponent(RepoVertexAttributes::POSITION, 2) };
 
             const unsigned int max_bits = 16;
             float max_quant = powf(2.0f, (float)max_bits) - 1.0f;
 
-            bool has_tex = (uvChannel != NULL);
+            bool has_tex = attributes.has(RepoVertexAttributes::UV_CHANNEL_0);
             float min_texcoordu = 0.0f, max_texcoordu = 0.0f;
             float min_texcoordv = 0.0f, max_texcoordv = 0.0f;
 
             if (has_tex)
             {
-                for(unsigned int vert_num = 0; vert_num < num_verts; vert_num++)
-                {
-                    for(unsigned int comp_idx = 0; comp_idx < 2; comp_idx++)
-                    {
-                        if (comp_idx == 0) {
-                            if (vert_num == 0) {
-                                min_texcoordu = (*uvChannel)[vert_num][comp_idx];
-                                max_texcoordu = (*uvChannel)[vert_num][comp_idx];
-                            } else {
-                                if ((*uvChannel)[vert_num][comp_idx] < min_texcoordu)
-                                    min_texcoordu = (*uvChannel)[vert_num][comp_idx];
-                                if ((*uvChannel)[vert_num][comp_idx] > max_texcoordu)
-                                    max_texcoordu = (*uvChannel)[vert_num][comp_idx];
-                            }
-                        }
-
-                        if (comp_idx == 1) {
-                            if (vert_num == 0) {
-                                min_texcoordv = (*uvChannel)[vert_num][comp_idx];
-                                max_texcoordv = (*uvChannel)[vert_num][comp_idx];
-                            } else {
-                                if ((*uvChannel)[vert_num][comp_idx] < min_texcoordv)
-                                    min_texcoordv = (*uvChannel)[vert_num][comp_idx];
-                                if ((*uvChannel)[vert_num][comp_idx] > max_texcoordv)
-                                    max_texcoordv = (*uvChannel)[vert_num][comp_idx];
-                            }
-                        }
-                    }
-                }
+                float min_texcoord[2], max_texcoord[2];
+                attributes.getMinMax(RepoVertexAttributes::UV_CHANNEL_0,
+                                     min_texcoord, max_texcoord);
+                min_texcoordu = min_texcoord[0];
+                max_texcoordu = max_texcoord[0];
+                min_texcoordv = min_texcoord[1];
+                max_texcoordv = max_texcoord[1];
                 stride = 16;
-           }
+            }
 
-			for(unsigned int vert_num = 0; vert_num < num_verts; vert_num++)
+			// One pass per coordinate over its contiguous array
+			const float bboxSize[3] = { bboxSizeX, bboxSizeY, bboxSizeZ };
+			for (unsigned int comp_idx = 0; comp_idx < 3; comp_idx++)
 			{
-				uint16_t vert_x_normal = (uint16_t)floor((((*verts)[vert_num][0] - bbox.getMin()[0]) / bboxSizeX) * max_quant + 0.5f);
-				uint16_t vert_y_normal = (uint16_t)floor((((*verts)[vert_num][1] - bbox.getMin()[1]) / bboxSizeY) * max_quant + 0.5f);
-				uint16_t vert_z_normal = (uint16_t)floor((((*verts)[vert_num][2] - bbox.getMin()[2]) / bboxSizeZ) * max_quant + 0.5f);
-
-				vertex_quant[vert_num][0] = vert_x_normal;
-				vertex_quant[vert_num][1] = vert_y_normal;
-				vertex_quant[vert_num][2] = vert_z_normal;
-
+				const float *coords = position[comp_idx];
+				const float bboxMin = bbox.getMin()[comp_idx];
+				const float scale = max_quant / bboxSize[comp_idx];
+				for(unsigned int vert_num = 0; vert_num < num_verts; vert_num++)
+					vertex_quant[vert_num][comp_idx] = (uint16_t)floor(
+						(coords[vert_num * attr_stride] - bboxMin) * scale + 0.5f);
 			}
 
-            const std::vector<aiFace> *faces = mesh->getFaces();
-            const std::vector<aiVector3t<float> > *normals = mesh->getNormals();
-        
+            const repo::core::RepoFaceBuffer *faces = mesh->getFaces();
+
             if (faces != NULL)
             {
                 unsigned int num_faces = faces->size();
@@ -175,7 +167,7 @@ void repo::core::Renderer::renderToBSONs(std::vector<mongo::BSONObj> &out)
 
                   for(unsigned int tri_num = 0; tri_num < num_faces; tri_num++)
                   {
-					const aiFace &curr_face = (*faces)[tri_num];
+					const repo::core::RepoFace curr_face = (*faces)[tri_num];
 
                     if (!valid_tri[tri_num])
                     {
@@ -215,7 +207,8 @@ void repo::core::Renderer::renderToBSONs(std::vector<mongo::BSONObj> &out)
 
                                     // Write normals in 8-bit
                                     for (unsigned int comp_idx = 0; comp_idx < 3; comp_idx++) {
-                                        uint8_t comp = (uint8_t)(floor(((*normals)[vert_num][comp_idx] + 1) * 127 + 0.5));
+                                        float n = normal[comp_idx] ? normal[comp_idx][vert_num * attr_stride] : 0.0f;
+                                        uint8_t comp = (uint8_t)(floor((n + 1) * 127 + 0.5));
                                         vert_buf[vert_buf_ptr] = comp;
                                         vert_buf_ptr++;
                                     }
@@ -226,7 +219,7 @@ void repo::core::Renderer::renderToBSONs(std::vector<mongo::BSONObj> &out)
                                     
                                     if (has_tex) {
                                         for (unsigned int comp_idx = 0; comp_idx < 2; comp_idx++) {
-                                            float wrap_tex = (*uvChannel)[vert_num][comp_idx];
+                                            float wrap_tex = uv[comp_idx][vert_num * attr_stride];
 
                                             if (comp_idx == 0)
                                                 wrap_tex = (wrap_tex - min_texcoordu) / (max_texcoordu - min_texcoordu);
@@ -17,6 +17,26 @@
 
 #include "repo_eigen.h"
 
+#include <algorithm>
+//------------------------------------------------------------------------------
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define REPO_EIGEN_SSE2
+#	include <emmintrin.h>
+
+namespace {
+
+//! Returns the sum of the four float lanes in double precision.
+inline double horizontalSum(__m128 v)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, v);
+	return ((double) lanes[0] + lanes[1]) + ((double) lanes[2] + lanes[3]);
+}
+
+} // end namespace
+#endif
+
 //------------------------------------------------------------------------------
 //
 // General calculations
@@ -182,6 +202,104 @@ aiMatrix3x3t<double> repo::core::RepoEigen::covarianceMatrix(
 	return covarianceMatrix;
 }
 
+aiMatrix3x3t<double> repo::core::RepoEigen::meanAndCovariance(
+	const float *x,
+	const float *y,
+	const float *z,
+	size_t stride,
+	size_t count,
+	RepoVertex& mean)
+{
+	mean = RepoVertex();
+	if (0 == count || !x || !y || !z)
+		return aiMatrix3x3t<double>(0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+	//---------------------------------------------------------------------
+	// Sums s of differences d from the first vertex and p of their
+	// products, from which mean = x0 + s / n and the sample covariance is
+	// (p - s s' / n) / (n - 1).
+	const float x0 = x[0], y0 = y[0], z0 = z[0];
+	double sx = 0, sy = 0, sz = 0;
+	double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+	size_t i = 0;
+
+#ifdef REPO_EIGEN_SSE2
+	if (1 == stride)
+	{
+		// Short blocks keep the float sums precise
+		const size_t blockSize = 256;
+		const size_t vectorized = count - count % 4;
+		const __m128 ox = _mm_set1_ps(x0);
+		const __m128 oy = _mm_set1_ps(y0);
+		const __m128 oz = _mm_set1_ps(z0);
+		while (i < vectorized)
+		{
+			__m128 bx = _mm_setzero_ps(), by = bx, bz = bx;
+			__m128 bxx = bx, bxy = bx, bxz = bx, byy = bx, byz = bx, bzz = bx;
+			size_t end = std::min(vectorized, i + blockSize);
+			for (; i < end; i += 4)
+			{
+				__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), ox);
+				__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), oy);
+				__m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), oz);
+				bx = _mm_add_ps(bx, dx);
+				by = _mm_add_ps(by, dy);
+				bz = _mm_add_ps(bz, dz);
+				bxx = _mm_add_ps(bxx, _mm_mul_ps(dx, dx));
+				bxy = _mm_add_ps(bxy, _mm_mul_ps(dx, dy));
+				bxz = _mm_add_ps(bxz, _mm_mul_ps(dx, dz));
+				byy = _mm_add_ps(byy, _mm_mul_ps(dy, dy));
+				byz = _mm_add_ps(byz, _mm_mul_ps(dy, dz));
+				bzz = _mm_add_ps(bzz, _mm_mul_ps(dz, dz));
+			}
+			sx += horizontalSum(bx);
+			sy += horizontalSum(by);
+			sz += horizontalSum(bz);
+			xx += horizontalSum(bxx);
+			xy += horizontalSum(bxy);
+			xz += horizontalSum(bxz);
+			yy += horizontalSum(byy);
+			yz += horizontalSum(byz);
+			zz += horizontalSum(bzz);
+		}
+	}
+#endif
+
+	//---------------------------------------------------------------------
+	// Remaining or strided vertices
+	for (; i < count; ++i)
+	{
+		double dx = x[i * stride] - x0;
+		double dy = y[i * stride] - y0;
+		double dz = z[i * stride] - z0;
+		sx += dx;
+		sy += dy;
+		sz += dz;
+		xx += dx * dx;
+		xy += dx * dy;
+		xz += dx * dz;
+		yy += dy * dy;
+		yz += dy * dz;
+		zz += dz * dz;
+	}
+
+	double n = (double) count;
+	mean = RepoVertex(
+		(float) (x0 + sx / n), (float) (y0 + sy / n), (float) (z0 + sz / n));
+
+	double multiplier = count > 1 ? 1.0 / (n - 1) : 0;
+	xx = (xx - sx * sx / n) * multiplier;
+	xy = (xy - sx * sy / n) * multiplier;
+	xz = (xz - sx * sz / n) * multiplier;
+	yy = (yy - sy * sy / n) * multiplier;
+	yz = (yz - sy * sz / n) * multiplier;
+	zz = (zz - sz * sz / n) * multiplier;
+	return aiMatrix3x3t<double>(
+		xx, xy, xz,
+		xy, yy, yz,
+		xz, yz, zz);
+}
+
 //------------------------------------------------------------------------------
 //
 // Eigenvalue decomposition
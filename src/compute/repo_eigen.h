@@ -140,6 +140,22 @@ public :
 		const std::vector<RepoVertex>& vertices,
 		const RepoVertex& mean);
 
+	/*!
+	 * Returns the covariance matrix of unweighted vertices given as separate
+	 * arrays of x, y and z coordinates along with their mean in a single
+	 * pass. Sums are taken relative to the first vertex to keep them small.
+	 * Contiguous arrays, ie stride 1, are processed four vertices at a time
+	 * with SSE2 where available, in blocks summed in float and accumulated
+	 * in double.
+	 */
+	static aiMatrix3x3t<double> meanAndCovariance(
+		const float *x,
+		const float *y,
+		const float *z,
+		size_t stride,
+		size_t count,
+		RepoVertex& mean);
+
 	//-------------------------------------------------------------------------
 	//
 	// Eigenvalue decomposition
@@ -17,6 +17,12 @@
 
 #include "repo_pca.h"
 #include <iostream>
+//------------------------------------------------------------------------------
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define REPO_PCA_SSE2
+#   include <emmintrin.h>
+#endif
 
 repo::core::RepoPCA::RepoPCA() {}
 
@@ -44,11 +50,164 @@ void repo::core::RepoPCA::initialize(
 	
     //--------------------------------------------------------------------------
 	// Eigenvalue decomposition of the covariance matrix
+    setBasis(RepoEigen::covarianceMatrix(xyzVertices, xyzMean));
+
+    //--------------------------------------------------------------------------
+	// Rotate the vertices around the xyzMean to the UVW space to get the bbox.
+    uvwMin = RepoVertex(RepoVertex::getMaxVertex<float>());
+    uvwMax = RepoVertex(RepoVertex::getMinVertex<float>());
+
+
+    uvwVertices.clear();
+    //uvwVertices.reserve(vertices.size());
+    sumOfWeights = 0;
+    for (unsigned int i = 0; i < xyzVertices.size(); ++i)
+    {
+        RepoVertex uvwVertex = transformToUVW(xyzVertices[i]);
+        uvwVertex.updateMinMax(uvwMin, uvwMax);
+        uvwVertices.push_back(uvwVertex);
+
+        uvwMean += RepoVertex(uvwVertex * (float) uvwVertex.weight);
+        sumOfWeights += uvwVertex.weight;
+    }
+    uvwMean /= (float) sumOfWeights; //(float) vertices.size();
+
+    setBoundingBox();
+}
+
+void repo::core::RepoPCA::initialize(const std::vector<aiVector3D>& xyzVertices)
+{
+    // Interleaved floats, no weighted copy needed
+    const float *xyz = xyzVertices.empty() ? NULL : &xyzVertices[0].x;
+    initialize(xyz, xyz + 1, xyz + 2,
+               sizeof(aiVector3D) / sizeof(float), xyzVertices.size());
+}
+
+void repo::core::RepoPCA::initialize(const RepoVertexAttributes& xyzVertices)
+{
+    const float *x = xyzVertices.getComponent(RepoVertexAttributes::POSITION, 0);
+    const float *y = xyzVertices.getComponent(RepoVertexAttributes::POSITION, 1);
+    const float *z = xyzVertices.getComponent(RepoVertexAttributes::POSITION, 2);
+    initialize(x, y, z, xyzVertices.getStride(), x ? xyzVertices.size() : 0);
+}
+
+void repo::core::RepoPCA::initialize(
+        const float *x,
+        const float *y,
+        const float *z,
+        size_t stride,
+        size_t count)
+{
+    if (!x || !y || !z)
+        count = 0;
+
+    //--------------------------------------------------------------------------
+	// Unweighted mean and covariance in a single pass
+    setBasis(RepoEigen::meanAndCovariance(x, y, z, stride, count, xyzMean));
+
+    //--------------------------------------------------------------------------
+	// Rotate the vertices around the xyzMean to the UVW space in bulk, along
+	// with their bbox and mean.
+    uvwMin = RepoVertex(RepoVertex::getMaxVertex<float>());
+    uvwMax = RepoVertex(RepoVertex::getMinVertex<float>());
+    uvwVertices.resize(count);
+    double sumU = 0, sumV = 0, sumW = 0;
+    size_t i = 0;
+
+#ifdef REPO_PCA_SSE2
+    if (1 == stride && count >= 4)
+    {
+        const aiMatrix3x3t<float> &r = uvwRotationMatrix;
+        const __m128 ra1 = _mm_set1_ps(r.a1), ra2 = _mm_set1_ps(r.a2), ra3 = _mm_set1_ps(r.a3);
+        const __m128 rb1 = _mm_set1_ps(r.b1), rb2 = _mm_set1_ps(r.b2), rb3 = _mm_set1_ps(r.b3);
+        const __m128 rc1 = _mm_set1_ps(r.c1), rc2 = _mm_set1_ps(r.c2), rc3 = _mm_set1_ps(r.c3);
+        const __m128 mx = _mm_set1_ps(xyzMean.x);
+        const __m128 my = _mm_set1_ps(xyzMean.y);
+        const __m128 mz = _mm_set1_ps(xyzMean.z);
+
+        __m128 minU = _mm_set1_ps(uvwMin.x), maxU = _mm_set1_ps(uvwMax.x);
+        __m128 minV = _mm_set1_ps(uvwMin.y), maxV = _mm_set1_ps(uvwMax.y);
+        __m128 minW = _mm_set1_ps(uvwMin.z), maxW = _mm_set1_ps(uvwMax.z);
+        __m128d sumUV = _mm_setzero_pd(), sumW2 = _mm_setzero_pd();
+
+        float u[4], v[4], w[4];
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), mx);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), my);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), mz);
+            __m128 pu = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(ra1, dx), _mm_mul_ps(ra2, dy)), _mm_mul_ps(ra3, dz));
+            __m128 pv = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(rb1, dx), _mm_mul_ps(rb2, dy)), _mm_mul_ps(rb3, dz));
+            __m128 pw = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(rc1, dx), _mm_mul_ps(rc2, dy)), _mm_mul_ps(rc3, dz));
+
+            minU = _mm_min_ps(minU, pu); maxU = _mm_max_ps(maxU, pu);
+            minV = _mm_min_ps(minV, pv); maxV = _mm_max_ps(maxV, pv);
+            minW = _mm_min_ps(minW, pw); maxW = _mm_max_ps(maxW, pw);
+
+            // Pairwise sums of the lanes accumulated in double
+            __m128 su = _mm_add_ps(pu, _mm_movehl_ps(pu, pu));
+            __m128 sv = _mm_add_ps(pv, _mm_movehl_ps(pv, pv));
+            __m128 sw = _mm_add_ps(pw, _mm_movehl_ps(pw, pw));
+            sumUV = _mm_add_pd(sumUV, _mm_add_pd(
+                    _mm_cvtps_pd(_mm_unpacklo_ps(su, sv)),
+                    _mm_cvtps_pd(_mm_unpacklo_ps(_mm_shuffle_ps(su, su, 1),
+                                                 _mm_shuffle_ps(sv, sv, 1)))));
+            sumW2 = _mm_add_pd(sumW2, _mm_cvtps_pd(sw));
+
+            _mm_storeu_ps(u, pu);
+            _mm_storeu_ps(v, pv);
+            _mm_storeu_ps(w, pw);
+            for (unsigned int k = 0; k < 4; ++k)
+                uvwVertices[i + k] = aiVector3D(u[k], v[k], w[k]);
+        }
+
+        double uv[2], w2[2];
+        _mm_storeu_pd(uv, sumUV);
+        _mm_storeu_pd(w2, sumW2);
+        sumU = uv[0];
+        sumV = uv[1];
+        sumW = w2[0] + w2[1];
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, minU); uvwMin.x = *std::min_element(lanes, lanes + 4);
+        _mm_storeu_ps(lanes, minV); uvwMin.y = *std::min_element(lanes, lanes + 4);
+        _mm_storeu_ps(lanes, minW); uvwMin.z = *std::min_element(lanes, lanes + 4);
+        _mm_storeu_ps(lanes, maxU); uvwMax.x = *std::max_element(lanes, lanes + 4);
+        _mm_storeu_ps(lanes, maxV); uvwMax.y = *std::max_element(lanes, lanes + 4);
+        _mm_storeu_ps(lanes, maxW); uvwMax.z = *std::max_element(lanes, lanes + 4);
+    }
+#endif
+
+    //--------------------------------------------------------------------------
+	// Remaining or strided vertices
+    for (; i < count; ++i)
+    {
+        RepoVertex uvwVertex = transformToUVW(
+                    RepoVertex(x[i * stride], y[i * stride], z[i * stride]));
+        uvwVertex.updateMinMax(uvwMin, uvwMax);
+        uvwVertices[i] = uvwVertex;
+        sumU += uvwVertex.x;
+        sumV += uvwVertex.y;
+        sumW += uvwVertex.z;
+    }
+    uvwMean = count > 0
+            ? RepoVertex((float) (sumU / count),
+                         (float) (sumV / count),
+                         (float) (sumW / count))
+            : RepoVertex();
+
+    setBoundingBox();
+}
+
+void repo::core::RepoPCA::setBasis(const aiMatrix3x3& covarianceMatrix)
+{
 	double eigenVectors[3][3];
 	double eigenValues[3];
 	// Calculated eigenValues (and vectors) are in ascending order.
 	// Eigenvectors are in the respective columns.
-    aiMatrix3x3 covarianceMatrix = RepoEigen::covarianceMatrix(xyzVertices, xyzMean);
 	RepoEigen::eigenvalueDecomposition(covarianceMatrix, eigenVectors, eigenValues);
 
     //--------------------------------------------------------------------------
@@ -82,26 +241,10 @@ void repo::core::RepoPCA::initialize(
     //--------------------------------------------------------------------------
 	// The inverse rotation, in this particular case T^-1 == T'
     xyzRotationMatrix = aiMatrix3x3t<float>(uvwRotationMatrix).Transpose();
-	
-    //--------------------------------------------------------------------------
-	// Rotate the vertices around the xyzMean to the UVW space to get the bbox.
-    uvwMin = RepoVertex(RepoVertex::getMaxVertex<float>());
-    uvwMax = RepoVertex(RepoVertex::getMinVertex<float>());
-
-
-    //uvwVertices.reserve(vertices.size());
-    sumOfWeights = 0;
-    for (unsigned int i = 0; i < xyzVertices.size(); ++i)
-    {
-        RepoVertex uvwVertex = transformToUVW(xyzVertices[i]);
-        uvwVertex.updateMinMax(uvwMin, uvwMax);
-        uvwVertices.push_back(uvwVertex);
+}
 
-        uvwMean += RepoVertex(uvwVertex * (float) uvwVertex.weight);
-        sumOfWeights += uvwVertex.weight;
-    }
-    uvwMean /= (float) sumOfWeights; //(float) vertices.size();
-	
+void repo::core::RepoPCA::setBoundingBox()
+{
     //--------------------------------------------------------------------------
 	// Store the lengths of the eigenvector oriented bounding box and calculate
 	// the new midpoint in UVW.
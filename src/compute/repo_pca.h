@@ -26,6 +26,7 @@
 #include "repo_eigen.h"
 #include "../primitives/repo_vertex.h"
 #include "../graph/repo_bounding_box.h"
+#include "../primitives/repovertexattributes.h"
 #include "../repocoreglobal.h"
 
 namespace repo {
@@ -100,8 +101,14 @@ public :
      * The same initialization but with unweighted vertices (each will have a
      * weight of 1.0)
      */
-    void initialize(const std::vector<aiVector3D>& xyzVertices)
-    { initialize(std::vector<RepoVertex>(xyzVertices.begin(), xyzVertices.end())); }
+    void initialize(const std::vector<aiVector3D>& xyzVertices);
+
+    /*!
+     * The same unweighted initialization from the positions of the given
+     * attributes, preferably in structure of arrays layout which is
+     * processed with SSE2 where available.
+     */
+    void initialize(const RepoVertexAttributes& xyzVertices);
 	 	
 	//! Returns the principal components vector in descending order of bases. 
 	std::vector<RepoPrincipalComponent> getPrincipalComponents() const
@@ -140,8 +147,8 @@ public :
 	//! Returns the max of the PCA oriented bbox in XYZ coordinate system.
     RepoVertex getMax() const { return xyzMax; }
 
-    std::vector<aiVector3D> getUnweightedUVWVertices() const
-    { return std::vector<aiVector3D>(uvwVertices.begin(), uvwVertices.end()); }
+    const std::vector<aiVector3D> &getUnweightedUVWVertices() const
+    { return uvwVertices; }
 
     RepoBoundingBox getXYZBoundingBox() const
     { return RepoBoundingBox(xyzMin, xyzMax); }
@@ -169,7 +176,31 @@ public :
 
 private :
 
-    std::vector<RepoVertex> uvwVertices;
+    /*!
+     * Unweighted initialization from separate arrays of x, y and z
+     * coordinates, consecutive values being stride floats apart. Mean and
+     * covariance are computed in a single pass and all vertices are then
+     * transformed to UVW in bulk.
+     */
+    void initialize(
+            const float *x,
+            const float *y,
+            const float *z,
+            size_t stride,
+            size_t count);
+
+    /*!
+     * Decomposes the covariance matrix into the principal components and sets
+     * the rotations in between XYZ and UVW.
+     */
+    void setBasis(const aiMatrix3x3& covarianceMatrix);
+
+    //! Sets magnitudes and centroids once uvwMin and uvwMax are known.
+    void setBoundingBox();
+
+private :
+
+    std::vector<aiVector3D> uvwVertices;
 
     //--------------------------------------------------------------------------
 	//
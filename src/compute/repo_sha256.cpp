@@ -0,0 +1,316 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_sha256.h"
+
+#include <cstring>
+#include <algorithm>
+//------------------------------------------------------------------------------
+#if defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86)
+#   define REPO_SHA256_X86
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define REPO_SHA256_TARGET
+#   else
+#       include <cpuid.h>
+#       define REPO_SHA256_TARGET __attribute__((target("sha,sse4.1")))
+#   endif
+#endif
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+//------------------------------------------------------------------------------
+//
+// Portable
+//
+//------------------------------------------------------------------------------
+
+inline uint32_t rotr(uint32_t x, unsigned int n)
+{ return (x >> n) | (x << (32 - n)); }
+
+inline uint32_t loadBigEndian(const uint8_t *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) |
+           ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3];
+}
+
+void transformPortable(uint32_t *state, const uint8_t *blocks, size_t count)
+{
+    uint32_t w[64];
+    for (; count > 0; --count, blocks += repo::core::RepoSHA256::BLOCK_SIZE)
+    {
+        for (unsigned int t = 0; t < 16; ++t)
+            w[t] = loadBigEndian(blocks + 4 * t);
+        for (unsigned int t = 16; t < 64; ++t)
+        {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (unsigned int t = 0; t < 64; ++t)
+        {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                    ((e & f) ^ (~e & g)) + K[t] + w[t];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                    ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+//------------------------------------------------------------------------------
+//
+// SHA extensions
+//
+//------------------------------------------------------------------------------
+#ifdef REPO_SHA256_X86
+
+bool hasSHAExtensions()
+{
+    // SHA is reported in leaf 7, SSSE3 and SSE4.1 used alongside in leaf 1
+    unsigned int regs1[4] = {0, 0, 0, 0};
+    unsigned int regs7[4] = {0, 0, 0, 0};
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    regs1[2] = info[2];
+    __cpuidex(info, 7, 0);
+    regs7[1] = info[1];
+#else
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid(1, regs1[0], regs1[1], regs1[2], regs1[3]);
+    __cpuid_count(7, 0, regs7[0], regs7[1], regs7[2], regs7[3]);
+#endif
+    bool ssse3 = 0 != (regs1[2] & (1u << 9));
+    bool sse41 = 0 != (regs1[2] & (1u << 19));
+    bool sha = 0 != (regs7[1] & (1u << 29));
+    return ssse3 && sse41 && sha;
+}
+
+/*!
+ * Each group of four rounds adds the message words to the constants and runs
+ * two sha256rnds2 instructions, meanwhile the message schedule of the group
+ * twelve rounds ahead is computed in place of the words just consumed.
+ */
+REPO_SHA256_TARGET
+void transformSHAExtensions(uint32_t *state, const uint8_t *blocks, size_t count)
+{
+    const __m128i byteSwap = _mm_set_epi64x(
+                0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // State is kept as ABEF and CDGH as required by sha256rnds2
+    __m128i tmp = _mm_shuffle_epi32(
+                _mm_loadu_si128((const __m128i *) &state[0]), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(
+                _mm_loadu_si128((const __m128i *) &state[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+    for (; count > 0; --count, blocks += repo::core::RepoSHA256::BLOCK_SIZE)
+    {
+        __m128i abefSaved = state0;
+        __m128i cdghSaved = state1;
+
+        __m128i msg[4];
+        for (unsigned int i = 0; i < 4; ++i)
+            msg[i] = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *) (blocks + 16 * i)),
+                        byteSwap);
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            __m128i words = _mm_add_epi32(
+                        msg[i % 4], _mm_loadu_si128((const __m128i *) &K[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+            state0 = _mm_sha256rnds2_epu32(
+                        state0, state1, _mm_shuffle_epi32(words, 0x0E));
+
+            if (i < 12)
+            {
+                __m128i next = _mm_sha256msg1_epu32(msg[i % 4], msg[(i + 1) % 4]);
+                next = _mm_add_epi32(
+                            next, _mm_alignr_epi8(msg[(i + 3) % 4], msg[(i + 2) % 4], 4));
+                msg[i % 4] = _mm_sha256msg2_epu32(next, msg[(i + 3) % 4]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSaved);
+        state1 = _mm_add_epi32(state1, cdghSaved);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+    _mm_storeu_si128((__m128i *) &state[0],
+                     _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+    _mm_storeu_si128((__m128i *) &state[4],
+                     _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+#endif // REPO_SHA256_X86
+
+typedef void (*TransformFunction)(uint32_t *, const uint8_t *, size_t);
+
+//! Returns the fastest transform on this machine, detected only once.
+TransformFunction getTransform()
+{
+#ifdef REPO_SHA256_X86
+    static const TransformFunction transform = hasSHAExtensions()
+            ? transformSHAExtensions
+            : transformPortable;
+    return transform;
+#else
+    return transformPortable;
+#endif
+}
+
+} // end namespace
+
+//------------------------------------------------------------------------------
+
+void repo::core::RepoSHA256::reset()
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(state, initial, sizeof(state));
+    length = 0;
+    buffered = 0;
+}
+
+void repo::core::RepoSHA256::update(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    length += size;
+
+    //--------------------------------------------------------------------------
+    // Complete the pending block first
+    if (buffered > 0)
+    {
+        size_t copied = std::min(size, BLOCK_SIZE - buffered);
+        memcpy(buffer + buffered, bytes, copied);
+        buffered += copied;
+        bytes += copied;
+        size -= copied;
+        if (buffered < BLOCK_SIZE)
+            return;
+        transform(state, buffer, 1);
+        buffered = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    // Whole blocks straight from the input, the rest is kept for later
+    size_t blocks = size / BLOCK_SIZE;
+    if (blocks > 0)
+        transform(state, bytes, blocks);
+    buffered = size - blocks * BLOCK_SIZE;
+    if (buffered > 0)
+        memcpy(buffer, bytes + blocks * BLOCK_SIZE, buffered);
+}
+
+void repo::core::RepoSHA256::final(uint8_t *digest)
+{
+    //--------------------------------------------------------------------------
+    // Padding: 0x80, zeros and the message length in bits, big endian
+    uint64_t bits = length * 8;
+    uint8_t padding[2 * BLOCK_SIZE];
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    size_t paddingSize = (buffered < BLOCK_SIZE - 8 ? BLOCK_SIZE : 2 * BLOCK_SIZE)
+            - buffered;
+    for (unsigned int i = 0; i < 8; ++i)
+        padding[paddingSize - 1 - i] = (uint8_t) (bits >> (8 * i));
+    update(padding, paddingSize);
+
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        digest[4 * i] = (uint8_t) (state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) state[i];
+    }
+}
+
+std::string repo::core::RepoSHA256::finalHex()
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    uint8_t digest[DIGEST_SIZE];
+    final(digest);
+
+    std::string hex(2 * DIGEST_SIZE, '0');
+    for (size_t i = 0; i < DIGEST_SIZE; ++i)
+    {
+        hex[2 * i] = hexDigits[digest[i] >> 4];
+        hex[2 * i + 1] = hexDigits[digest[i] & 0x0f];
+    }
+    return hex;
+}
+
+std::string repo::core::RepoSHA256::hash(const void *data, size_t size)
+{
+    RepoSHA256 sha;
+    sha.update(data, size);
+    return sha.finalHex();
+}
+
+repo::core::RepoSHA256::Implementation repo::core::RepoSHA256::getImplementation()
+{
+    return transformPortable == getTransform() ? PORTABLE : SHA_EXTENSIONS;
+}
+
+void repo::core::RepoSHA256::transform(
+        uint32_t *state,
+        const uint8_t *blocks,
+        size_t count)
+{
+    getTransform()(state, blocks, count);
+}
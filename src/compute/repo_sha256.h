@@ -0,0 +1,102 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_SHA256_H
+#define REPO_SHA256_H
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//------------------------------------------------------------------------------
+/*!
+ * Incremental SHA-256 (FIPS 180-4) over raw buffers.
+ *
+ * Data can be fed in pieces of any size by update(), full 64-byte blocks are
+ * compressed straight from the caller's buffer and only a partial block is
+ * ever copied. Blocks are compressed by the x86 SHA extensions when the CPU
+ * supports them, which is detected once at runtime, otherwise by portable
+ * code. Both give identical digests.
+ */
+class REPO_CORE_EXPORT RepoSHA256
+{
+
+public :
+
+    //! Implementations of the block compression.
+    enum Implementation { PORTABLE, SHA_EXTENSIONS };
+
+    static const size_t DIGEST_SIZE = 32;
+
+    static const size_t BLOCK_SIZE = 64;
+
+public :
+
+    //! Starts a new message.
+    RepoSHA256() { reset(); }
+
+    //--------------------------------------------------------------------------
+
+    //! Discards everything hashed so far and starts a new message.
+    void reset();
+
+    //! Appends size bytes of data to the message.
+    void update(const void *data, size_t size);
+
+    /*!
+     * Completes the message and writes DIGEST_SIZE bytes of its digest.
+     * The hasher has to be reset() before it can be used again.
+     */
+    void final(uint8_t *digest);
+
+    //! Completes the message and returns its digest as a lowercase hex string.
+    std::string finalHex();
+
+    //--------------------------------------------------------------------------
+
+    //! Returns the hex digest of a single buffer.
+    static std::string hash(const void *data, size_t size);
+
+    //! Returns the implementation used on this machine.
+    static Implementation getImplementation();
+
+private :
+
+    //! Compresses consecutive 64-byte blocks into the state.
+    static void transform(uint32_t *state, const uint8_t *blocks, size_t count);
+
+private :
+
+    uint32_t state[8]; //!< Intermediate hash value.
+
+    uint64_t length; //!< Message length in bytes so far.
+
+    uint8_t buffer[BLOCK_SIZE]; //!< Pending partial block.
+
+    size_t buffered; //!< Number of bytes in the buffer.
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_SHA256_H
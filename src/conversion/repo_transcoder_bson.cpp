@@ -17,6 +17,27 @@
 
 #include "repo_transcoder_bson.h"
 
+//------------------------------------------------------------------------------
+const unsigned int repo::core::RepoTranscoderBSON::INDEX_KEYS_COUNT = 1024;
+//------------------------------------------------------------------------------
+
+//! Decimal strings of 0 to INDEX_KEYS_COUNT - 1.
+static std::vector<std::string> createIndexKeys()
+{
+	std::vector<std::string> keys;
+	keys.reserve(repo::core::RepoTranscoderBSON::INDEX_KEYS_COUNT);
+	for (unsigned int i = 0; i < repo::core::RepoTranscoderBSON::INDEX_KEYS_COUNT; ++i)
+		keys.push_back(boost::lexical_cast<std::string>(i));
+	return keys;
+}
+
+const std::string &repo::core::RepoTranscoderBSON::getIndexKey(unsigned int index)
+{
+	// Initialised once, thread safe in C++11
+	static const std::vector<std::string> keys = createIndexKeys();
+	return keys[index];
+}
+
 void repo::core::RepoTranscoderBSON::append(
 		const std::string &label,
 		const boost::uuids::uuid &uuid,
@@ -36,11 +57,11 @@ void repo::core::RepoTranscoderBSON::append(
 		const aiColor3D &color,
 		mongo::BSONObjBuilder &builder)
 {
-	std::vector<float> vec;
-	vec.push_back(color.r);
-	vec.push_back(color.g);
-	vec.push_back(color.b);
-	append(label, vec, builder);
+	mongo::BSONObjBuilder array(builder.subarrayStart(label));
+	array.append(getIndexKey(0), color.r);
+	array.append(getIndexKey(1), color.g);
+	array.append(getIndexKey(2), color.b);
+	array.done();
 }
 
 void repo::core::RepoTranscoderBSON::append(
@@ -48,12 +69,12 @@ void repo::core::RepoTranscoderBSON::append(
 		const aiColor4D &color,
 		mongo::BSONObjBuilder &builder)
 {
-	std::vector<float> vec;
-	vec.push_back(color.r);
-	vec.push_back(color.g);
-	vec.push_back(color.b);
-	vec.push_back(color.a);
-	append(label, vec, builder);
+	mongo::BSONObjBuilder array(builder.subarrayStart(label));
+	array.append(getIndexKey(0), color.r);
+	array.append(getIndexKey(1), color.g);
+	array.append(getIndexKey(2), color.b);
+	array.append(getIndexKey(3), color.a);
+	array.done();
 }
 
 
@@ -21,6 +21,7 @@
 #include <set>
 #include <vector>
 #include <utility>
+#include <algorithm>
 //-----------------------------------------------------------------------------
 #include <boost/lexical_cast.hpp>
 #include <boost/uuid/uuid.hpp> 
@@ -32,6 +33,7 @@
 //-----------------------------------------------------------------------------
 
 #include "../repocoreglobal.h"
+#include "../primitives/repobinaryview.h"
 
 using namespace std;
 
@@ -62,6 +64,10 @@ public :
 
 	//-------------------------------------------------------------------------
 	//! Appends a vector as an array to BSON builder.
+	/*!
+	 * Elements are written straight into the buffer of the builder using
+	 * precomputed index keys, see getIndexKey().
+	 */
 	template <class T>
 	static void append
 	(
@@ -70,10 +76,13 @@ public :
 		mongo::BSONObjBuilder &builder
 	)
 	{
-		mongo::BSONObjBuilder array;
+		mongo::BSONObjBuilder array(builder.subarrayStart(label));
 		for (unsigned int i = 0; i < vec.size(); ++i)
-			append(boost::lexical_cast<string>(i), vec[i], array);
-		builder.appendArray(label, array.obj());
+			if (i < INDEX_KEYS_COUNT)
+				append(getIndexKey(i), vec[i], array);
+			else
+				append(boost::lexical_cast<string>(i), vec[i], array);
+		array.done();
 	}
 
 	//-------------------------------------------------------------------------
@@ -86,12 +95,15 @@ public :
 		mongo::BSONObjBuilder &builder
 	)
 	{
-		mongo::BSONObjBuilder array;
-		int i = 0;
+		mongo::BSONObjBuilder array(builder.subarrayStart(label));
+		unsigned int i = 0;
 		typename std::set<T>::const_iterator it = set.begin();
 		for (; it != set.end(); ++it, ++i)
-			append(boost::lexical_cast<string>(i), *it, array);		
-		builder.appendArray(label, array.obj());
+			if (i < INDEX_KEYS_COUNT)
+				append(getIndexKey(i), *it, array);
+			else
+				append(boost::lexical_cast<string>(i), *it, array);
+		array.done();
 	}
 
 
@@ -105,10 +117,10 @@ public :
 		mongo::BSONObjBuilder &builder
 	)
 	{
-		std::vector<T> vec;
-		vec.push_back(vertex.x);
-		vec.push_back(vertex.y);
-		append(label, vec, builder);
+		mongo::BSONObjBuilder array(builder.subarrayStart(label));
+		array.append(getIndexKey(0), vertex.x);
+		array.append(getIndexKey(1), vertex.y);
+		array.done();
 	}
 
 	//-------------------------------------------------------------------------
@@ -121,11 +133,11 @@ public :
 		mongo::BSONObjBuilder &builder
 	)
 	{
-		std::vector<T> vec;
-		vec.push_back(vertex.x);
-		vec.push_back(vertex.y);
-		vec.push_back(vertex.z);
-		append(label, vec, builder);
+		mongo::BSONObjBuilder array(builder.subarrayStart(label));
+		array.append(getIndexKey(0), vertex.x);
+		array.append(getIndexKey(1), vertex.y);
+		array.append(getIndexKey(2), vertex.z);
+		array.done();
 	}
 
 	//-------------------------------------------------------------------------
@@ -145,21 +157,39 @@ public :
 		const std::string &countLabel = ""
 	) 
 	{	
-		if (0 < data->size())
+		append(label, RepoBinaryView<T>(data), builder, byteCountLabel, countLabel);
+    }
+
+	//-------------------------------------------------------------------------
+	//! Appends a binary view as binary mongo::BinDataGeneral type array.
+	/*!
+	 * \sa append(const std::string &, const std::vector<T> *, ...)
+	 */
+	template <class T>
+	static void append
+	(
+		const std::string &label, 
+		const RepoBinaryView<T> &data, 
+		mongo::BSONObjBuilder &builder,
+		const std::string &byteCountLabel = "",
+		const std::string &countLabel = ""
+	) 
+	{	
+		if (0 < data.size())
 		{			
 			if (!byteCountLabel.empty())
                 builder << byteCountLabel << (unsigned int) (
-                               data->size() * sizeof(T));
+                               data.size() * sizeof(T));
 
 			// Store size of the array for decoding purposes
 			if (!countLabel.empty()) 			
-				builder << countLabel << (unsigned int) (data->size());	
+				builder << countLabel << (unsigned int) (data.size());	
 				
 			// Store provided vector as a binary blob (treated like an array)
 			// http://api.mongodb.org/cplusplus/1.9.0/bsontypes_8h_source.html
 			builder.appendBinData(
-				label, (data->size() * sizeof(T)), mongo::BinDataGeneral, 
-				(char *) &(data->at(0)) );  
+				label, (data.size() * sizeof(T)), mongo::BinDataGeneral, 
+				data.bytes());  
 		}
     }
 
@@ -184,6 +214,16 @@ public :
 		const aiColor4D &color,
 		mongo::BSONObjBuilder &builder);
 
+	//-------------------------------------------------------------------------
+	//! Number of precomputed array index keys.
+	static const unsigned int INDEX_KEYS_COUNT;
+
+	/*!
+	 * Returns the precomputed BSON array key of given index, ie its decimal
+	 * string. Index has to be smaller than INDEX_KEYS_COUNT.
+	 */
+	static const std::string &getIndexKey(unsigned int index);
+
 	//-------------------------------------------------------------------------
 	//
 	// Retrieval 
@@ -231,13 +271,31 @@ public :
 		if (NULL != vec && bse.binDataType() == mongo::BinDataGeneral) 
 		{
 			vec->resize(vectorSize);
-            bse.value();
-            int length;// = static_cast<int>(vectorSize * sizeof(T));
+            int length = 0;
             const char *binData = bse.binData(length);
-            memcpy(&(vec->at(0)), binData, length);
+            // Never copy more than the vector can hold
+            size_t byteCount = std::min(
+                        (size_t) std::max(length, 0), vectorSize * sizeof(T));
+            if (byteCount > 0)
+                memcpy(&(vec->at(0)), binData, byteCount);
 		}
     }
 
+	//! Retrieves binary array as a view borrowing from the object's buffer.
+	/*!
+	 * Unlike retrieve(), the data is not copied, the view keeps the BSON
+	 * buffer alive instead, whether or not the blob is aligned for T.
+	 * \sa RepoBinaryView
+	 */
+	template <class T>
+	static RepoBinaryView<T> retrieveView(
+		const mongo::BSONObj &obj,
+		const std::string &label,
+		const unsigned int vectorSize)
+	{
+		return RepoBinaryView<T>(obj, label, vectorSize);
+	}
+
 }; // end class
 
 } // end namespace core
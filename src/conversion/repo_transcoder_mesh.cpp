@@ -0,0 +1,627 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_transcoder_mesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+//
+// LZ codec constants
+//
+//------------------------------------------------------------------------------
+
+namespace {
+
+//! Shortest match worth encoding.
+const size_t LZ_MIN_MATCH = 4;
+
+//! Longest distance a match can refer back to.
+const size_t LZ_MAX_OFFSET = 65535;
+
+//! Number of trailing bytes always emitted as literals.
+const size_t LZ_LAST_LITERALS = 5;
+
+//! Log2 of the number of entries of the match finder hash table.
+const unsigned int LZ_HASH_BITS = 14;
+
+uint32_t read32(const uint8_t *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+//! Writes a length which did not fit into its 4-bit token field.
+void writeLength(size_t length, std::vector<uint8_t> &out)
+{
+	for (; length >= 255; length -= 255)
+		out.push_back(255);
+	out.push_back((uint8_t) length);
+}
+
+//! Reads a length continuation, returns false if the input ends first.
+bool readLength(const uint8_t *&ip, const uint8_t *end, size_t &length)
+{
+	uint8_t byte = 255;
+	while (255 == byte)
+	{
+		if (ip >= end)
+			return false;
+		byte = *ip++;
+		length += byte;
+	}
+	return true;
+}
+
+//! Appends a sequence of literals followed by an optional match.
+void writeSequence(
+	const uint8_t *literals,
+	size_t literalsLength,
+	size_t matchLength,
+	size_t offset,
+	std::vector<uint8_t> &out)
+{
+	size_t matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+	out.push_back((uint8_t) ((std::min(literalsLength, (size_t) 15) << 4) |
+		std::min(matchCode, (size_t) 15)));
+	if (literalsLength >= 15)
+		writeLength(literalsLength - 15, out);
+	out.insert(out.end(), literals, literals + literalsLength);
+	if (matchLength > 0)
+	{
+		out.push_back((uint8_t) (offset & 0xFF));
+		out.push_back((uint8_t) (offset >> 8));
+		if (matchCode >= 15)
+			writeLength(matchCode - 15, out);
+	}
+}
+
+} // end namespace
+
+//------------------------------------------------------------------------------
+//
+// Positions
+//
+//------------------------------------------------------------------------------
+
+std::vector<uint16_t> repo::core::RepoTranscoderMesh::quantizePositions(
+	const RepoBinaryView<aiVector3D> &positions,
+	const aiVector3D &min,
+	const aiVector3D &max)
+{
+	size_t count = positions.size();
+	std::vector<uint16_t> quantized(3 * count);
+	for (unsigned int c = 0; c < 3 && count > 0; ++c)
+	{
+		float extent = max[c] - min[c];
+		float scale = extent > 0 ? 65535.0f / extent : 0.0f;
+		uint16_t *component = &quantized[0] + c * count;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float q = std::floor((positions[i][c] - min[c]) * scale + 0.5f);
+			component[i] = (uint16_t) std::min(std::max(q, 0.0f), 65535.0f);
+		}
+	}
+	return quantized;
+}
+
+void repo::core::RepoTranscoderMesh::dequantizePositions(
+	const uint16_t *quantized,
+	size_t count,
+	const aiVector3D &min,
+	const aiVector3D &max,
+	std::vector<aiVector3D> &positions)
+{
+	positions.resize(count);
+	for (unsigned int c = 0; c < 3; ++c)
+	{
+		float step = (max[c] - min[c]) / 65535.0f;
+		const uint16_t *component = quantized + c * count;
+		for (size_t i = 0; i < count; ++i)
+			positions[i][c] = min[c] + component[i] * step;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Normals
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoTranscoderMesh::octEncode(
+	const aiVector3D &normal,
+	int16_t &u,
+	int16_t &v)
+{
+	float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	float x = 0, y = 0;
+	// Also catches NaNs assigned by Assimp to normals of points and lines
+	if (l1 > 0)
+	{
+		x = normal.x / l1;
+		y = normal.y / l1;
+		if (normal.z < 0)
+		{
+			float t = x;
+			x = (1 - std::fabs(y)) * (t >= 0 ? 1 : -1);
+			y = (1 - std::fabs(t)) * (y >= 0 ? 1 : -1);
+		}
+	}
+	u = (int16_t) std::floor(std::min(std::max(x, -1.0f), 1.0f) * 32767 + 0.5f);
+	v = (int16_t) std::floor(std::min(std::max(y, -1.0f), 1.0f) * 32767 + 0.5f);
+}
+
+aiVector3D repo::core::RepoTranscoderMesh::octDecode(int16_t u, int16_t v)
+{
+	float x = std::max(u / 32767.0f, -1.0f);
+	float y = std::max(v / 32767.0f, -1.0f);
+	float z = 1 - std::fabs(x) - std::fabs(y);
+	if (z < 0)
+	{
+		float t = x;
+		x = (1 - std::fabs(y)) * (t >= 0 ? 1 : -1);
+		y = (1 - std::fabs(t)) * (y >= 0 ? 1 : -1);
+	}
+	aiVector3D normal(x, y, z);
+	return normal.Normalize();
+}
+
+std::vector<int16_t> repo::core::RepoTranscoderMesh::encodeNormals(
+	const RepoBinaryView<aiVector3D> &normals)
+{
+	size_t count = normals.size();
+	std::vector<int16_t> encoded(2 * count);
+	for (size_t i = 0; i < count; ++i)
+		octEncode(normals[i], encoded[i], encoded[count + i]);
+	return encoded;
+}
+
+void repo::core::RepoTranscoderMesh::decodeNormals(
+	const int16_t *encoded,
+	size_t count,
+	std::vector<aiVector3D> &normals)
+{
+	normals.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		normals[i] = octDecode(encoded[i], encoded[count + i]);
+}
+
+std::vector<int16_t> repo::core::RepoTranscoderMesh::encodeTangents(
+	const RepoBinaryView<aiVector3D> &normals,
+	const RepoBinaryView<aiVector3D> &tangents,
+	const RepoBinaryView<aiVector3D> &bitangents)
+{
+	size_t count = tangents.size();
+	std::vector<int16_t> encoded(3 * count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		octEncode(tangents[i], encoded[i], encoded[count + i]);
+		aiVector3D expected = normals[i] ^ tangents[i];
+		encoded[2 * count + i] = (expected * bitangents[i] < 0) ? -1 : 1;
+	}
+	return encoded;
+}
+
+void repo::core::RepoTranscoderMesh::decodeTangents(
+	const int16_t *encoded,
+	size_t count,
+	const RepoBinaryView<aiVector3D> &normals,
+	std::vector<aiVector3D> &tangents,
+	std::vector<aiVector3D> &bitangents)
+{
+	decodeNormals(encoded, count, tangents);
+	bitangents.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		aiVector3D bitangent = normals[i] ^ tangents[i];
+		if (bitangent.Length() > 0)
+			bitangent.Normalize();
+		bitangents[i] = bitangent * (encoded[2 * count + i] < 0 ? -1.0f : 1.0f);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Bone weights
+//
+//------------------------------------------------------------------------------
+
+std::vector<uint8_t> repo::core::RepoTranscoderMesh::encodeBoneWeights(
+	const aiBone * const *bones,
+	unsigned int bonesCount,
+	size_t verticesCount)
+{
+	const unsigned int n = BONE_INFLUENCES_COUNT;
+	std::vector<uint8_t> encoded(verticesCount * 2 * n, 0);
+
+	//--------------------------------------------------------------------------
+	// Largest weights of every vertex in descending order, inserted one by one
+	std::vector<float> largest(verticesCount * n, 0.0f);
+	for (unsigned int b = 0; b < bonesCount && b < BONES_COUNT_LIMIT; ++b)
+	{
+		if (NULL == bones[b] || NULL == bones[b]->mWeights)
+			continue;
+		for (unsigned int j = 0; j < bones[b]->mNumWeights; ++j)
+		{
+			const aiVertexWeight &weight = bones[b]->mWeights[j];
+			if (weight.mVertexId >= verticesCount || !(weight.mWeight > 0))
+				continue;
+			float *w = &largest[weight.mVertexId * n];
+			uint8_t *indices = &encoded[weight.mVertexId * 2 * n];
+			unsigned int k = n;
+			for (; k > 0 && w[k - 1] < weight.mWeight; --k)
+				if (k < n)
+				{
+					w[k] = w[k - 1];
+					indices[k] = indices[k - 1];
+				}
+			if (k < n)
+			{
+				w[k] = weight.mWeight;
+				indices[k] = (uint8_t) b;
+			}
+		}
+	}
+
+	//--------------------------------------------------------------------------
+	// Normalized to sum up to 255, the rounding error is distributed to the
+	// weights with the largest remainders.
+	for (size_t i = 0; i < verticesCount; ++i)
+	{
+		const float *w = &largest[i * n];
+		uint8_t *quantized = &encoded[i * 2 * n + n];
+		float sum = 0;
+		for (unsigned int k = 0; k < n; ++k)
+			sum += w[k];
+		if (!(sum > 0))
+			continue;
+
+		float remainders[BONE_INFLUENCES_COUNT];
+		unsigned int total = 0;
+		for (unsigned int k = 0; k < n; ++k)
+		{
+			float scaled = std::min(w[k] * 255.0f / sum, 255.0f);
+			quantized[k] = (uint8_t) scaled;
+			remainders[k] = scaled - quantized[k];
+			total += quantized[k];
+		}
+		for (unsigned int r = 0; r < n && total < 255; ++r, ++total)
+		{
+			unsigned int k = (unsigned int) (
+				std::max_element(remainders, remainders + n) - remainders);
+			++quantized[k];
+			remainders[k] = -1;
+		}
+	}
+	return encoded;
+}
+
+void repo::core::RepoTranscoderMesh::decodeBoneWeights(
+	const uint8_t *encoded,
+	size_t verticesCount,
+	unsigned int bonesCount,
+	std::vector<std::vector<aiVertexWeight> > &weights)
+{
+	const unsigned int n = BONE_INFLUENCES_COUNT;
+	weights.assign(bonesCount, std::vector<aiVertexWeight>());
+	for (size_t i = 0; i < verticesCount; ++i)
+		for (unsigned int k = 0; k < n; ++k)
+		{
+			uint8_t bone = encoded[i * 2 * n + k];
+			uint8_t weight = encoded[i * 2 * n + n + k];
+			if (weight > 0 && bone < bonesCount)
+				weights[bone].push_back(
+					aiVertexWeight((unsigned int) i, weight / 255.0f));
+		}
+}
+
+//------------------------------------------------------------------------------
+//
+// Indices
+//
+//------------------------------------------------------------------------------
+
+std::vector<uint32_t> repo::core::RepoTranscoderMesh::optimizeVertexCache(
+	const std::vector<uint32_t> &indices,
+	size_t vertexCount,
+	unsigned int cacheSize)
+{
+	size_t trianglesCount = indices.size() / 3;
+	for (size_t i = 0; i < trianglesCount * 3; ++i)
+		if (indices[i] >= vertexCount)
+			return indices; // invalid mesh, keep as is
+
+	//--------------------------------------------------------------------------
+	// Triangles adjacent to each vertex and number of those not yet emitted
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < trianglesCount * 3; ++i)
+		++live[indices[i]];
+	std::vector<size_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<uint32_t> adjacency(trianglesCount * 3);
+	std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < trianglesCount * 3; ++i)
+		adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+
+	//--------------------------------------------------------------------------
+	std::vector<size_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(trianglesCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> reordered;
+	reordered.reserve(trianglesCount * 3);
+
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+	long long fanning = vertexCount > 0 ? 0 : -1;
+	while (fanning >= 0)
+	{
+		// Emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (size_t a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+		{
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				uint32_t v = indices[3 * t + k];
+				reordered.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				if (time - timestamps[v] > cacheSize)
+					timestamps[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// Next fanning vertex is the one still in cache the longest
+		long long next = -1;
+		long long bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); ++c)
+		{
+			uint32_t v = candidates[c];
+			if (live[v] > 0)
+			{
+				long long priority = 0;
+				if (time - timestamps[v] + 2 * live[v] <= cacheSize)
+					priority = (long long) (time - timestamps[v]);
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+		}
+
+		// Otherwise the most recent dead end or the next vertex in order
+		while (next < 0 && !deadEnd.empty())
+		{
+			uint32_t d = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[d] > 0)
+				next = d;
+		}
+		for (; next < 0 && cursor < vertexCount; ++cursor)
+			if (live[cursor] > 0)
+				next = (long long) cursor;
+		fanning = next;
+	}
+	return reordered;
+}
+
+std::vector<uint32_t> repo::core::RepoTranscoderMesh::getFirstUseOrder(
+	const std::vector<uint32_t> &indices,
+	size_t vertexCount)
+{
+	const uint32_t unused = 0xFFFFFFFF;
+	std::vector<uint32_t> order(vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+		if (indices[i] < vertexCount && unused == order[indices[i]])
+			order[indices[i]] = next++;
+	for (size_t v = 0; v < vertexCount; ++v)
+		if (unused == order[v])
+			order[v] = next++;
+	return order;
+}
+
+std::vector<uint32_t> repo::core::RepoTranscoderMesh::encodeIndices(
+	const std::vector<uint32_t> &indices)
+{
+	std::vector<uint32_t> encoded(indices.size());
+	uint32_t previous = 0;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		int32_t delta = (int32_t) (indices[i] - previous);
+		encoded[i] = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+		previous = indices[i];
+	}
+	return encoded;
+}
+
+void repo::core::RepoTranscoderMesh::decodeIndices(
+	const uint32_t *encoded,
+	size_t count,
+	std::vector<uint32_t> &indices)
+{
+	indices.resize(count);
+	uint32_t previous = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t delta = (encoded[i] >> 1) ^ (0 - (encoded[i] & 1));
+		previous += delta;
+		indices[i] = previous;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Byte planes and LZ
+//
+//------------------------------------------------------------------------------
+
+std::vector<uint8_t> repo::core::RepoTranscoderMesh::toBytePlanes(
+	const void *data,
+	size_t count,
+	size_t elementSize)
+{
+	const uint8_t *bytes = (const uint8_t *) data;
+	std::vector<uint8_t> planes(count * elementSize);
+	for (size_t b = 0; b < elementSize && count > 0; ++b)
+	{
+		uint8_t *plane = &planes[0] + b * count;
+		for (size_t i = 0; i < count; ++i)
+			plane[i] = bytes[i * elementSize + b];
+	}
+	return planes;
+}
+
+void repo::core::RepoTranscoderMesh::fromBytePlanes(
+	const uint8_t *planes,
+	size_t count,
+	size_t elementSize,
+	void *out)
+{
+	uint8_t *bytes = (uint8_t *) out;
+	for (size_t b = 0; b < elementSize; ++b)
+	{
+		const uint8_t *plane = planes + b * count;
+		for (size_t i = 0; i < count; ++i)
+			bytes[i * elementSize + b] = plane[i];
+	}
+}
+
+std::vector<uint8_t> repo::core::RepoTranscoderMesh::compress(
+	const uint8_t *data,
+	size_t size)
+{
+	std::vector<uint8_t> out(sizeof(uint32_t));
+	uint32_t header = (uint32_t) size;
+	memcpy(&out[0], &header, sizeof(header));
+	out.reserve(sizeof(uint32_t) + size + size / 255 + 16);
+
+	size_t anchor = 0;
+	if (size > LZ_MIN_MATCH + LZ_LAST_LITERALS)
+	{
+		std::vector<int64_t> table((size_t) 1 << LZ_HASH_BITS, -1);
+		size_t limit = size - LZ_LAST_LITERALS;
+		size_t ip = 0;
+		while (ip + LZ_MIN_MATCH <= limit)
+		{
+			uint32_t sequence = read32(data + ip);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+			int64_t ref = table[hash];
+			table[hash] = (int64_t) ip;
+
+			if (ref >= 0 && ip - (size_t) ref <= LZ_MAX_OFFSET &&
+				read32(data + ref) == sequence)
+			{
+				size_t length = LZ_MIN_MATCH;
+				while (ip + length < limit && data[ref + length] == data[ip + length])
+					++length;
+				writeSequence(data + anchor, ip - anchor, length, ip - (size_t) ref, out);
+				ip += length;
+				anchor = ip;
+			}
+			else
+				++ip;
+		}
+	}
+	writeSequence(data + anchor, size - anchor, 0, 0, out);
+	return out;
+}
+
+bool repo::core::RepoTranscoderMesh::decompress(
+	const uint8_t *data,
+	size_t size,
+	size_t maxSize,
+	std::vector<uint8_t> &out)
+{
+	out.clear();
+	if (size < sizeof(uint32_t) + 1)
+		return false;
+
+	// The stored size is not trusted with the allocation
+	uint32_t expected;
+	memcpy(&expected, data, sizeof(expected));
+	if (expected > maxSize)
+		return false;
+	out.resize(expected);
+
+	const uint8_t *ip = data + sizeof(uint32_t);
+	const uint8_t *end = data + size;
+	size_t op = 0;
+	bool success = true;
+	while (success)
+	{
+		if (ip >= end)
+		{
+			success = false;
+			break;
+		}
+		uint8_t token = *ip++;
+
+		// Literals
+		size_t literals = token >> 4;
+		if (15 == literals)
+			success = readLength(ip, end, literals);
+		if (!success || literals > (size_t) (end - ip) || literals > expected - op)
+		{
+			success = false;
+			break;
+		}
+		if (literals > 0)
+			memcpy(&out[op], ip, literals);
+		ip += literals;
+		op += literals;
+
+		// The last sequence has no match
+		if (ip == end)
+			break;
+
+		// Match, possibly overlapping the bytes it produces
+		if (end - ip < 2)
+		{
+			success = false;
+			break;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		size_t length = token & 0x0F;
+		if (15 == length)
+			success = readLength(ip, end, length);
+		length += LZ_MIN_MATCH;
+		if (!success || 0 == offset || offset > op || length > expected - op)
+		{
+			success = false;
+			break;
+		}
+		for (size_t i = 0; i < length; ++i, ++op)
+			out[op] = out[op - offset];
+	}
+
+	success = success && op == expected;
+	if (!success)
+		out.clear();
+	return success;
+}
@@ -0,0 +1,262 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_TRANSCODER_MESH_H
+#define REPO_TRANSCODER_MESH_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+#include <assimp/scene.h> // Assimp
+//-----------------------------------------------------------------------------
+
+#include "../repocoreglobal.h"
+#include "../primitives/repobinaryview.h"
+
+namespace repo {
+namespace core {
+
+/*!
+ * Static class of pure functions compressing mesh geometry for API level 3.
+ *
+ * Positions are quantized to 16 bits relative to a bounding box, normals are
+ * octahedron encoded into two 16-bit values and triangle indices are
+ * reordered for the vertex cache, then stored as zigzag encoded deltas.
+ * Every attribute is laid out component by component and split into byte
+ * planes, ie all lowest bytes first, so that similar bytes are adjacent,
+ * and finally compressed by a byte oriented LZ77 codec. Decoding is a
+ * sequence of flat loops over contiguous arrays without branches on the
+ * data, except for the LZ stage itself.
+ */
+class REPO_CORE_EXPORT RepoTranscoderMesh
+{
+
+public :
+
+	//-------------------------------------------------------------------------
+	//
+	// Positions
+	//
+	//-------------------------------------------------------------------------
+
+	/*!
+	 * Quantizes positions to 16 bits per component within [min, max]. Returns
+	 * all x, then all y, then all z components. Positions outside the box are
+	 * clamped.
+	 */
+	static std::vector<uint16_t> quantizePositions(
+		const RepoBinaryView<aiVector3D> &positions,
+		const aiVector3D &min,
+		const aiVector3D &max);
+
+	//! Inverse of quantizePositions().
+	static void dequantizePositions(
+		const uint16_t *quantized,
+		size_t count,
+		const aiVector3D &min,
+		const aiVector3D &max,
+		std::vector<aiVector3D> &positions);
+
+	//-------------------------------------------------------------------------
+	//
+	// Normals
+	//
+	//-------------------------------------------------------------------------
+
+	//! Octahedron encodes a unit vector into two signed normalized values.
+	static void octEncode(const aiVector3D &normal, int16_t &u, int16_t &v);
+
+	//! Inverse of octEncode(), returns a unit vector.
+	static aiVector3D octDecode(int16_t u, int16_t v);
+
+	//! Returns all u, then all v values of the octahedron encoded normals.
+	static std::vector<int16_t> encodeNormals(
+		const RepoBinaryView<aiVector3D> &normals);
+
+	//! Inverse of encodeNormals().
+	static void decodeNormals(
+		const int16_t *encoded,
+		size_t count,
+		std::vector<aiVector3D> &normals);
+
+	/*!
+	 * Returns all u, then all v values of the octahedron encoded tangents
+	 * followed by the handedness of each tangent frame, ie +1 if the
+	 * bitangent points along normal x tangent and -1 otherwise. All three
+	 * views have to be of the same size.
+	 */
+	static std::vector<int16_t> encodeTangents(
+		const RepoBinaryView<aiVector3D> &normals,
+		const RepoBinaryView<aiVector3D> &tangents,
+		const RepoBinaryView<aiVector3D> &bitangents);
+
+	/*!
+	 * Inverse of encodeTangents(), each bitangent is reconstructed as the
+	 * unit cross product of the normal and the tangent times the handedness.
+	 * Normals have to hold count elements.
+	 */
+	static void decodeTangents(
+		const int16_t *encoded,
+		size_t count,
+		const RepoBinaryView<aiVector3D> &normals,
+		std::vector<aiVector3D> &tangents,
+		std::vector<aiVector3D> &bitangents);
+
+	//-------------------------------------------------------------------------
+	//
+	// Bone weights
+	//
+	//-------------------------------------------------------------------------
+
+	//! Number of bones that can influence a single vertex.
+	static const unsigned int BONE_INFLUENCES_COUNT = 4;
+
+	//! Highest number of bones that can be referenced by the influences.
+	static const unsigned int BONES_COUNT_LIMIT = 256;
+
+	/*!
+	 * Packs bone weights into 8 bytes per vertex, the 8-bit indices of the
+	 * four most influential bones followed by their weights quantized to
+	 * 8 bits such that they sum up to 255. Weights of bones beyond
+	 * BONES_COUNT_LIMIT are dropped, unused slots are zero.
+	 */
+	static std::vector<uint8_t> encodeBoneWeights(
+		const aiBone * const *bones,
+		unsigned int bonesCount,
+		size_t verticesCount);
+
+	/*!
+	 * Inverse of encodeBoneWeights(), returns the non-zero weights of each of
+	 * the bonesCount bones.
+	 */
+	static void decodeBoneWeights(
+		const uint8_t *encoded,
+		size_t verticesCount,
+		unsigned int bonesCount,
+		std::vector<std::vector<aiVertexWeight> > &weights);
+
+	//-------------------------------------------------------------------------
+	//
+	// Indices
+	//
+	//-------------------------------------------------------------------------
+
+	/*!
+	 * Returns triangles reordered for a post transform vertex cache of given
+	 * size using the Tipsify algorithm of Sander, Nehab and Barczak, 2007.
+	 */
+	static std::vector<uint32_t> optimizeVertexCache(
+		const std::vector<uint32_t> &indices,
+		size_t vertexCount,
+		unsigned int cacheSize = 16);
+
+	/*!
+	 * Returns new position of every vertex such that vertices are ordered by
+	 * their first use in the indices. Unused vertices are moved to the end.
+	 */
+	static std::vector<uint32_t> getFirstUseOrder(
+		const std::vector<uint32_t> &indices,
+		size_t vertexCount);
+
+	//! Returns differences of consecutive indices, zigzag encoded.
+	static std::vector<uint32_t> encodeIndices(
+		const std::vector<uint32_t> &indices);
+
+	//! Inverse of encodeIndices().
+	static void decodeIndices(
+		const uint32_t *encoded,
+		size_t count,
+		std::vector<uint32_t> &indices);
+
+	//-------------------------------------------------------------------------
+	//
+	// Byte planes and LZ
+	//
+	//-------------------------------------------------------------------------
+
+	/*!
+	 * Splits count elements of elementSize bytes into elementSize planes of
+	 * count bytes each, least significant first on little endian machines.
+	 */
+	static std::vector<uint8_t> toBytePlanes(
+		const void *data,
+		size_t count,
+		size_t elementSize);
+
+	//! Inverse of toBytePlanes(), out has to hold count * elementSize bytes.
+	static void fromBytePlanes(
+		const uint8_t *planes,
+		size_t count,
+		size_t elementSize,
+		void *out);
+
+	/*!
+	 * Compresses data with a byte oriented LZ77 codec. The result starts with
+	 * the uncompressed size as a 32-bit integer.
+	 */
+	static std::vector<uint8_t> compress(const uint8_t *data, size_t size);
+
+	/*!
+	 * Decompresses the output of compress(). Returns false if the input is
+	 * malformed or claims more than maxSize bytes, which is to be derived
+	 * from the counts the caller expects, in which case out is left empty.
+	 */
+	static bool decompress(
+		const uint8_t *data,
+		size_t size,
+		size_t maxSize,
+		std::vector<uint8_t> &out);
+
+	//-------------------------------------------------------------------------
+	//! Splits elements into byte planes and compresses them.
+	template <class T>
+	static std::vector<uint8_t> pack(const std::vector<T> &elements)
+	{
+		std::vector<uint8_t> planes = toBytePlanes(
+			elements.empty() ? NULL : &elements[0], elements.size(), sizeof(T));
+		return compress(planes.empty() ? NULL : &planes[0], planes.size());
+	}
+
+	/*!
+	 * Inverse of pack(), data does not need to be aligned. Returns false if
+	 * the data is malformed, holds more than maxCount elements or its size
+	 * is not a multiple of the element.
+	 */
+	template <class T>
+	static bool unpack(
+		const char *data,
+		size_t size,
+		size_t maxCount,
+		std::vector<T> &elements)
+	{
+		std::vector<uint8_t> planes;
+		bool success = decompress(
+			(const uint8_t *) data, size, maxCount * sizeof(T), planes) &&
+			0 == planes.size() % sizeof(T);
+		elements.resize(success ? planes.size() / sizeof(T) : 0);
+		if (success && !elements.empty())
+			fromBytePlanes(&planes[0], elements.size(), sizeof(T), &elements[0]);
+		return success;
+	}
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_TRANSCODER_MESH_H
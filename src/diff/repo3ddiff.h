@@ -47,11 +47,19 @@ public:
 
     RepoNodeRevision diff() const;
 
+    //! Hashes all meshes of A in parallel and groups them by their hashes.
     RepoSelfSimilarSet getSelfSimilarSetA() const
-    { return toSelfSimilarSet(A->getMeshes()); }
+    {
+        A->computeVertexHashes();
+        return toSelfSimilarSet(A->getMeshes());
+    }
 
+    //! Hashes all meshes of B in parallel and groups them by their hashes.
     RepoSelfSimilarSet getSelfSimilarSetB() const
-    { return toSelfSimilarSet(B->getMeshes()); }
+    {
+        B->computeVertexHashes();
+        return toSelfSimilarSet(B->getMeshes());
+    }
 
 
 public :
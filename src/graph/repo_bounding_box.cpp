@@ -23,24 +23,38 @@ repo::core::RepoBoundingBox::RepoBoundingBox(const aiMesh * mesh)
 {
 	if (mesh->mNumVertices)
 	{
-        min = RepoVertex(mesh->mVertices[0]);
-        max = RepoVertex(mesh->mVertices[0]);
+        min = mesh->mVertices[0];
+        max = mesh->mVertices[0];
 	}
 
-	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+	// Plain floats rather than RepoVertex temporaries keep the loop free of
+	// per vertex conversions
+	const aiVector3D *vertices = mesh->mVertices;
+	for (unsigned int i = 1; i < mesh->mNumVertices; ++i)
 	{
-        RepoVertex tmp = RepoVertex(mesh->mVertices[i]);
+		min.x = std::min(min.x, vertices[i].x);
+		min.y = std::min(min.y, vertices[i].y);
+		min.z = std::min(min.z, vertices[i].z);
 
-		min.x = std::min(min.x,tmp.x);
-		min.y = std::min(min.y,tmp.y);
-		min.z = std::min(min.z,tmp.z);
-
-		max.x = std::max(max.x,tmp.x);
-		max.y = std::max(max.y,tmp.y);
-		max.z = std::max(max.z,tmp.z);
+		max.x = std::max(max.x, vertices[i].x);
+		max.y = std::max(max.y, vertices[i].y);
+		max.z = std::max(max.z, vertices[i].z);
 	}
 }
 
+repo::core::RepoBoundingBox::RepoBoundingBox(
+        const RepoVertexAttributes &attributes)
+{
+    float lowest[3], highest[3];
+    if (attributes.getMinMax(RepoVertexAttributes::POSITION, lowest, highest))
+    {
+        min = aiVector3D(lowest[0], lowest[1], lowest[2]);
+        max = aiVector3D(highest[0], highest[1], highest[2]);
+    }
+    else
+        *this = RepoBoundingBox();
+}
+
 repo::core::RepoBoundingBox::RepoBoundingBox(const std::vector<RepoVertex> &vertices)
 {
     if (vertices.size())
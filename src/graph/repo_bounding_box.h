@@ -24,6 +24,7 @@
 #include "assimp/scene.h"
 #include "../repocoreglobal.h"
 #include "../primitives/repo_vertex.h"
+#include "../primitives/repovertexattributes.h"
 
 namespace repo {
 namespace core {
@@ -55,6 +56,12 @@ public :
      */
     RepoBoundingBox(const std::vector<RepoVertex> &vertices);
 
+    /*!
+     * Constructs a bounding box from the positions of given attributes, one
+     * pass over each coordinate array in structure of arrays layout.
+     */
+    RepoBoundingBox(const RepoVertexAttributes &attributes);
+
     RepoBoundingBox(const RepoVertex& min, const RepoVertex& max)
         : min(min)
         , max(max) {}
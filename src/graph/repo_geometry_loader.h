@@ -0,0 +1,61 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_GEOMETRY_LOADER_H
+#define REPO_GEOMETRY_LOADER_H
+
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+class RepoNodeMesh;
+
+//! Abstract source of mesh geometry for meshes loaded without it.
+/*!
+ * Scenes can be retrieved as a skeleton only, ie without the binary geometry
+ * fields of meshes. Such meshes hold a pointer to a geometry loader which is
+ * asked to populate them the first time any of their geometry is accessed.
+ */
+class REPO_CORE_EXPORT RepoGeometryLoader
+{
+
+public :
+
+    //! Empty virtual destructor for proper cleanup.
+    virtual ~RepoGeometryLoader() {}
+
+    //! Registers a mesh whose geometry is to be loaded by this loader.
+    virtual void addMesh(RepoNodeMesh *mesh) = 0;
+
+    //! Unregisters a mesh, eg before it gets deleted.
+    virtual void removeMesh(RepoNodeMesh *mesh) = 0;
+
+    /*!
+     * Populates geometry of the given mesh, and possibly of other registered
+     * meshes in the same batch. Has to be thread safe. Returns true if
+     * the geometry has been loaded, false otherwise.
+     */
+    virtual bool load(RepoNodeMesh *mesh) = 0;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // end REPO_GEOMETRY_LOADER_H
@@ -16,9 +16,42 @@
  */
 
 #include "repo_graph_scene.h"
+#include "repo_scene_decoder.h"
+#include "../primitives/repothreadpool.h"
 #include <algorithm>
 #include <string>
 #include <cctype>
+#include <functional>
+#include <future>
+
+namespace {
+
+//! Deletes an array of pointers along with the objects they point to.
+template <class T>
+void deleteArray(T **array, unsigned int count)
+{
+	for (unsigned int i = 0; array && i < count; ++i)
+		delete array[i];
+	delete[] array;
+}
+
+/*!
+ * Deletes an aiScene orphaned from its importer. The aiScene destructor is
+ * defined empty in assimpwrapper.cpp, hence the contents go one by one.
+ */
+void deleteScene(aiScene *scene)
+{
+	deleteArray(scene->mMeshes, scene->mNumMeshes);
+	deleteArray(scene->mMaterials, scene->mNumMaterials);
+	deleteArray(scene->mAnimations, scene->mNumAnimations);
+	deleteArray(scene->mTextures, scene->mNumTextures);
+	deleteArray(scene->mLights, scene->mNumLights);
+	deleteArray(scene->mCameras, scene->mNumCameras);
+	delete scene->mRootNode;
+	delete scene;
+}
+
+} // end namespace
 
 //------------------------------------------------------------------------------
 //
@@ -28,8 +61,64 @@
 
 repo::core::RepoGraphScene::RepoGraphScene(
 	const aiScene* scene,
-	const std::map<std::string, RepoNodeAbstract*>& textures)
+	const std::map<std::string, RepoNodeAbstract*>& textures,
+	unsigned int meshApi,
+	unsigned int threads)
 	: RepoGraphAbstract()
+    , geometryLoader(NULL)
+{
+    populate(scene, textures, meshApi, threads, false);
+}
+
+repo::core::RepoGraphScene::RepoGraphScene(
+	std::unique_ptr<aiScene> scene,
+	const std::map<std::string, RepoNodeAbstract*>& textures,
+	unsigned int meshApi,
+	unsigned int threads)
+	: RepoGraphAbstract()
+    , geometryLoader(NULL)
+{
+    populate(scene.get(), textures, meshApi, threads, true);
+    deleteScene(scene.release());
+}
+
+
+repo::core::RepoGraphScene::RepoGraphScene(
+	const std::vector<mongo::BSONObj>& collection,
+    bool view)
+    : RepoGraphAbstract()
+    , geometryLoader(NULL)
+{
+	// To retrieve a graph, first identify a root node.
+	// The very root normally does not have any parents, but this has to be
+	// made more general as in the future it will be possible to retrieve a
+	// subgraph from the scene in which case the root of the subgraph will
+	// have his parents, however, will be the top-most node in the subgraph.
+	//
+	// This can be achieved through set intersections from paths.
+	// The root node of the subgraph is the one which is in the retrieved
+	// collection of objects and is referenced the most times by the nodes.
+	// set_intersection on paths can deliver the most occurrences.
+
+    RepoSceneDecoder decoder(this, view);
+    for (std::vector<mongo::BSONObj>::const_iterator it = collection.begin();
+         it != collection.end();
+         ++it)
+        decoder.decode(*it);
+
+    //--------------------------------------------------------------------------
+	// Build the parental graph.
+	decoder.finish();
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::RepoGraphScene::populate(
+	const aiScene* scene,
+	const std::map<std::string, RepoNodeAbstract*>& textures,
+	unsigned int meshApi,
+	unsigned int threads,
+	bool adopt)
 {
     //--------------------------------------------------------------------------
     // Textures
@@ -41,42 +130,100 @@ repo::core::RepoGraphScene::RepoGraphScene(
     }
 
     //--------------------------------------------------------------------------
-	// Materials
+	// Materials and meshes
+	//
+	// Converted concurrently, largest meshes first so that a single huge mesh
+	// does not end up last on one thread. Each node is written to the slot
+	// of its Assimp index, hence the order is the same as on a single thread.
+	// Linking to textures and materials modifies shared nodes, so it is done
+	// afterwards on this thread. Adopted aiMeshes are deleted as soon as they
+	// are converted.
 	//
 	// Warning: Default material might not be attached to anything,
 	// hence it would not be returned by a call to getNodes().
-	if (scene->HasMaterials())
+	const std::map<std::string, RepoNodeAbstract*> noTextures;
+	const std::vector<RepoNodeAbstract*> noMaterials;
+
+	materials.resize(scene->mNumMaterials);
+	std::vector<RepoNodeAbstract*> meshesVector(scene->mNumMeshes);
+
+	std::vector<unsigned int> meshesBySize(scene->mNumMeshes);
+	std::vector<unsigned int> meshMaterials(scene->mNumMeshes);
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
 	{
-		materials.reserve(scene->mNumMaterials);
-		for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+		meshesBySize[i] = i;
+		meshMaterials[i] = scene->mMeshes[i]->mMaterialIndex;
+	}
+	std::stable_sort(meshesBySize.begin(), meshesBySize.end(),
+		[scene](unsigned int a, unsigned int b)
+		{ return scene->mMeshes[a]->mNumVertices > scene->mMeshes[b]->mNumVertices; });
+
+	std::vector<std::function<void()> > conversions;
+	conversions.reserve(scene->mNumMaterials + scene->mNumMeshes);
+	for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+		conversions.push_back([this, scene, &noTextures, i]()
 		{
 			aiString name;
 			scene->mMaterials[i]->Get(AI_MATKEY_NAME, name);
-
-			RepoNodeAbstract* material = new RepoNodeMaterial(
+			materials[i] = new RepoNodeMaterial(
 				scene->mMaterials[i],
-				textures,
+				noTextures,
 				name.data);
-			materials.push_back(material);
-			nodesByUniqueID.insert(std::make_pair(material->getUniqueID(), material));
-		}
+		});
+	for (unsigned int i : meshesBySize)
+		conversions.push_back([this, scene, &noMaterials, &meshesVector, meshApi, adopt, i]()
+		{
+			if (adopt)
+			{
+				// Owned by this constructor, see RepoGraphScene(std::unique_ptr)
+				aiMesh *&mesh = const_cast<aiScene*>(scene)->mMeshes[i];
+				meshesVector[i] = new RepoNodeMesh(
+					meshApi,
+					std::unique_ptr<aiMesh>(mesh),
+					noMaterials);
+				mesh = NULL;
+			}
+			else
+				meshesVector[i] = new RepoNodeMesh(
+					meshApi,
+					scene->mMeshes[i],
+					noMaterials);
+		});
+
+	if (1 == threads || conversions.size() < 2)
+	{
+		for (size_t i = 0; i < conversions.size(); ++i)
+			conversions[i]();
+	}
+	else
+	{
+		RepoThreadPool pool(threads ? threads : RepoThreadPool::getDefaultSize());
+		std::vector<std::future<void> > futures;
+		futures.reserve(conversions.size());
+		for (size_t i = 0; i < conversions.size(); ++i)
+			futures.push_back(pool.submit(conversions[i]));
+		for (size_t i = 0; i < futures.size(); ++i)
+			futures[i].get();
 	}
 
-    //--------------------------------------------------------------------------
-	// Meshes
-    std::vector<RepoNodeAbstract*> meshesVector;
-	if (scene->HasMeshes())
+	for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+	{
+		static_cast<RepoNodeMaterial*>(materials[i])->attachTextures(
+			scene->mMaterials[i], textures);
+		nodesByUniqueID.insert(std::make_pair(materials[i]->getUniqueID(), materials[i]));
+	}
+
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
 	{
-		for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+		RepoNodeAbstract* mesh = meshesVector[i];
+		unsigned int materialIndex = meshMaterials[i];
+		if (materialIndex < materials.size())
 		{
-			RepoNodeAbstract* mesh = new RepoNodeMesh(
-				REPO_NODE_API_LEVEL_1,
-				scene->mMeshes[i],
-				materials);
-            meshes.insert(mesh);
-            meshesVector.push_back(mesh);
-			nodesByUniqueID.insert(std::make_pair(mesh->getUniqueID(), mesh));
+			mesh->addChild(materials[materialIndex]);
+			materials[materialIndex]->addParent(mesh);
 		}
+		meshes.insert(mesh);
+		nodesByUniqueID.insert(std::make_pair(mesh->getUniqueID(), mesh));
 	}
 
     //--------------------------------------------------------------------------
@@ -138,92 +285,6 @@ repo::core::RepoGraphScene::RepoGraphScene(
 }
 
 
-repo::core::RepoGraphScene::RepoGraphScene(
-	const std::vector<mongo::BSONObj>& collection) : RepoGraphAbstract()
-{
-	// To retrieve a graph, first identify a root node.
-	// The very root normally does not have any parents, but this has to be
-	// made more general as in the future it will be possible to retrieve a
-	// subgraph from the scene in which case the root of the subgraph will
-	// have his parents, however, will be the top-most node in the subgraph.
-	//
-	// This can be achieved through set intersections from paths.
-	// The root node of the subgraph is the one which is in the retrieved
-	// collection of objects and is referenced the most times by the nodes.
-	// set_intersection on paths can deliver the most occurrences.
-
-    std::map<boost::uuids::uuid, RepoNodeAbstract *> nodesBySharedID;
-    for (std::vector<mongo::BSONObj>::const_iterator it = collection.begin();
-         it != collection.end();
-         ++it)
-    {
-        mongo::BSONObj obj = *it;
-		RepoNodeAbstract *node = NULL;
-
-		std::string nodeType = obj.getField(REPO_NODE_LABEL_TYPE).str();
-
-		if (REPO_NODE_TYPE_TRANSFORMATION == nodeType)
-		{
-			node = new RepoNodeTransformation(obj);
-            transformations.insert(node);
-		}
-		else if (REPO_NODE_TYPE_MESH == nodeType)
-		{
-			node = new RepoNodeMesh(obj);
-            meshes.insert(node);
-		}
-		else if (REPO_NODE_TYPE_MATERIAL == nodeType)
-		{
-			node = new RepoNodeMaterial(obj);
-			materials.push_back(node);
-		}
-		else if (REPO_NODE_TYPE_TEXTURE == nodeType)
-		{
-            RepoNodeTexture *tex = new RepoNodeTexture(obj);
-			textures.push_back(tex);
-			node = tex;
-		}
-		else if (REPO_NODE_TYPE_CAMERA == nodeType)
-		{
-			node = new RepoNodeCamera(obj);
-			cameras.push_back(node);
-		}
-        else if (REPO_NODE_TYPE_REFERENCE == nodeType)
-        {
-            node = new RepoNodeReference(obj);
-            references.push_back(node);
-        }
-        else if (REPO_NODE_TYPE_METADATA == nodeType)
-        {
-            node = new RepoNodeMetadata(obj);
-            metadata.push_back(node);
-        }
-
-        //----------------------------------------------------------------------
-		if (!obj.hasField(REPO_NODE_LABEL_PARENTS))
-			rootNode = node;
-
-        //----------------------------------------------------------------------
-		// Skip objects of unrecognized type
-		if (node)
-		{
-			nodesByUniqueID.insert(std::make_pair(node->getUniqueID(), node));
-			// TODO: take care of multiple objects that have the same shared ID.
-			nodesBySharedID.insert(std::make_pair(node->getSharedID(), node));
-		}
-		else
-		{
-			std::cerr << "Unrecognized node type" << std::endl;
-			//RepoILogger::getInstance().log(repo::REPO_WARNING, "Node of unrecognized type.");
-		}
-	}
-
-    //--------------------------------------------------------------------------
-	// Build the parental graph.
-	buildGraph(nodesBySharedID);
-}
-
-
 //------------------------------------------------------------------------------
 //
 // Destructor
@@ -232,12 +293,86 @@ repo::core::RepoGraphScene::RepoGraphScene(
 
 repo::core::RepoGraphScene::~RepoGraphScene()
 {
+    // Loader might still be populating meshes in the background
+    delete geometryLoader;
+
     RepoNodeAbstractSet nodes = getNodes();
     RepoNodeAbstractSet::iterator it;
     for (it = nodes.begin(); it != nodes.end(); ++it)
         delete *it;
 }
 
+void repo::core::RepoGraphScene::setGeometryLoader(RepoGeometryLoader *loader)
+{
+    if (loader != geometryLoader)
+        delete geometryLoader;
+    geometryLoader = loader;
+
+    if (geometryLoader)
+    {
+        RepoNodeAbstractSet::iterator it;
+        for (it = meshes.begin(); it != meshes.end(); ++it)
+        {
+            RepoNodeMesh *mesh = dynamic_cast<RepoNodeMesh *>(*it);
+            if (mesh && !mesh->isGeometryLoaded())
+                geometryLoader->addMesh(mesh);
+        }
+    }
+}
+
+std::vector<mongo::BSONObj> repo::core::RepoGraphScene::toBSONObjs(
+        unsigned int threads) const
+{
+    computeVertexHashes(threads);
+
+    RepoNodeAbstractSet nodes = getNodes();
+    std::vector<mongo::BSONObj> objs;
+    objs.reserve(nodes.size());
+    RepoNodeAbstractSet::const_iterator it;
+    for (it = nodes.begin(); it != nodes.end(); ++it)
+        objs.push_back((*it)->toBSONObj());
+    return objs;
+}
+
+void repo::core::RepoGraphScene::computeVertexHashes(unsigned int threads) const
+{
+    //--------------------------------------------------------------------------
+    // Largest meshes first so that a single huge mesh does not end up last
+    // on one thread, idle threads keep taking the next mesh from the queue.
+    std::vector<RepoNodeMesh *> pending;
+    RepoNodeAbstractSet::const_iterator it;
+    for (it = meshes.begin(); it != meshes.end(); ++it)
+    {
+        RepoNodeMesh *mesh = dynamic_cast<RepoNodeMesh *>(*it);
+        if (mesh && !mesh->hasVertexHash())
+            pending.push_back(mesh);
+    }
+    std::stable_sort(pending.begin(), pending.end(),
+        [](const RepoNodeMesh *a, const RepoNodeMesh *b)
+        { return a->getVerticesCount() > b->getVerticesCount(); });
+
+    //--------------------------------------------------------------------------
+    // Every mesh is hashed by a single task, which is all it modifies
+    if (1 == threads || pending.size() < 2)
+    {
+        for (size_t i = 0; i < pending.size(); ++i)
+            pending[i]->setVertexHash();
+    }
+    else
+    {
+        RepoThreadPool pool(threads ? threads : RepoThreadPool::getDefaultSize());
+        std::vector<std::future<void> > futures;
+        futures.reserve(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            RepoNodeMesh *mesh = pending[i];
+            futures.push_back(pool.submit([mesh]() { mesh->setVertexHash(); }));
+        }
+        for (size_t i = 0; i < futures.size(); ++i)
+            futures[i].get();
+    }
+}
+
 void repo::core::RepoGraphScene::append(RepoNodeAbstract *thisNode, RepoGraphAbstract *thatGraph)
 {
     RepoGraphAbstract::append(thisNode, thatGraph);
@@ -300,6 +435,18 @@ repo::core::RepoNodeAbstractSet repo::core::RepoGraphScene::addMetadata(
 //------------------------------------------------------------------------------
 
 void repo::core::RepoGraphScene::toAssimp(aiScene *scene) const
+{
+    populateAssimp(scene, false);
+}
+
+void repo::core::RepoGraphScene::moveToAssimp(aiScene *scene)
+{
+    populateAssimp(scene, true);
+}
+
+void repo::core::RepoGraphScene::populateAssimp(
+        aiScene *scene,
+        bool moveGeometry) const
 {
     assert(NULL != scene);
 
@@ -348,7 +495,10 @@ void repo::core::RepoGraphScene::toAssimp(aiScene *scene) const
         for (unsigned int i = 0; it != meshes.end(); ++it, ++i)
         {
 			aiMesh *mesh = new aiMesh();
-            ((RepoNodeMesh*) *it)->toAssimp(materialsMapping, mesh);
+            if (moveGeometry)
+                ((RepoNodeMesh*) *it)->moveToAssimp(materialsMapping, mesh);
+            else
+                ((RepoNodeMesh*) *it)->toAssimp(materialsMapping, mesh);
 			mMeshes[i] = mesh;
             meshesMapping.insert(std::make_pair(*it, i));
 		}
@@ -453,6 +603,10 @@ void repo::core::RepoGraphScene::removeNodeRecursively(RepoNodeAbstract* node)
     transformations.erase(node);
     meshes.erase(node);
 
+    RepoNodeMesh *mesh = dynamic_cast<RepoNodeMesh *>(node);
+    if (geometryLoader && mesh)
+        geometryLoader->removeMesh(mesh);
+
     // Clean up memory
     delete node;
     node = 0;
@@ -19,6 +19,7 @@
 #define REPO_GRAPH_SCENE_H
 
 #include <vector>
+#include <memory>
 
 //-----------------------------------------------------------------------------
 #include "assimp/scene.h"
@@ -42,6 +43,8 @@ namespace core {
 class REPO_CORE_EXPORT RepoGraphScene : public RepoGraphAbstract
 {
 
+    friend class RepoSceneDecoder;
+
 public :
 
     //--------------------------------------------------------------------------
@@ -51,27 +54,55 @@ public :
     //--------------------------------------------------------------------------
 
 	//! Empty default constructor so that it can be registered as a qmetatype.
-    RepoGraphScene() : RepoGraphAbstract(new RepoNodeTransformation()) {}
+    RepoGraphScene()
+        : RepoGraphAbstract(new RepoNodeTransformation())
+        , geometryLoader(NULL) {}
 
 	//! Copy constructor
 	//RepoGraphScene(const RepoGraphScene &) : RepoGraphAbstract() {};
 
 	/*!
 	 * Constructs a graph from Assimp's aiScene and the given predefined
-	 * textures.
+	 * textures. Meshes are stored using given API level, see RepoNodeMesh.
+	 * Materials and meshes are converted on the given number of threads, all
+	 * hardware threads if 0. The resulting node order does not depend on it.
 	 *
 	 * \sa RepoGraphScene(), ~RepoGraphScene()
 	 */
 	RepoGraphScene(
 		const aiScene *scene,
-		const std::map<std::string, RepoNodeAbstract *> &textures);
+		const std::map<std::string, RepoNodeAbstract *> &textures,
+		unsigned int meshApi = REPO_NODE_API_LEVEL_1,
+		unsigned int threads = 0);
 
 	/*!
-	 * Constructs a graph from a collection of BSON objects.
+	 * Same as above, but takes ownership of the aiScene, eg as returned by
+	 * AssimpWrapper::releaseScene(). Vertices and normals are adopted by the
+	 * meshes instead of being copied and each aiMesh is deleted as soon as
+	 * it has been converted, the rest of the aiScene once the graph is built.
+	 *
+	 * \sa RepoNodeMesh::RepoNodeMesh(unsigned int, std::unique_ptr<aiMesh>, ...)
+	 */
+	RepoGraphScene(
+		std::unique_ptr<aiScene> scene,
+		const std::map<std::string, RepoNodeAbstract *> &textures,
+		unsigned int meshApi = REPO_NODE_API_LEVEL_1,
+		unsigned int threads = 0);
+
+	/*!
+	 * Constructs a graph from a collection of BSON objects, see
+	 * RepoSceneDecoder for decoding documents as they arrive. Mesh objects can
+	 * be retrieved without their geometry, in which case a geometry loader
+	 * should be set via setGeometryLoader(). In view mode, meshes and
+	 * textures borrow their binary data from the BSON objects instead of
+	 * copying it, so the collection can be released straight away without
+	 * the scene holding a second copy of it.
 	 *
 	 * \sa RepoGraphScene(), ~RepoGraphScene()
 	 */
-	RepoGraphScene(const std::vector<mongo::BSONObj> &collection);
+	RepoGraphScene(
+        const std::vector<mongo::BSONObj> &collection,
+        bool view = false);
 
 	//! Destructor for proper cleanup.
 	/*!
@@ -88,6 +119,30 @@ public :
     RepoNodeAbstractSet addMetadata(const RepoNodeAbstractSet& metadata,
                      bool exactMatch = true);
 
+    /*!
+     * Registers all meshes without geometry with the loader and takes
+     * ownership of it. Any previously set loader is deleted.
+     */
+    void setGeometryLoader(RepoGeometryLoader *loader);
+
+    //! Returns the geometry loader, NULL if not set.
+    RepoGeometryLoader *getGeometryLoader() const { return geometryLoader; }
+
+    /*!
+     * Calculates the vertex hashes of all meshes not hashed yet on the given
+     * number of threads, all hardware threads if 0, and stores them on the
+     * meshes, where RepoNodeMesh::getVertexHash() and toBSONObj() pick them
+     * up. Meshes without geometry are loaded by the geometry loader.
+     */
+    void computeVertexHashes(unsigned int threads = 0) const;
+
+    /*!
+     * Returns the BSON objects of all nodes of this scene to be committed.
+     * Vertex hashes are calculated first on the given number of threads, see
+     * computeVertexHashes(), so that every mesh is stored with its hash.
+     */
+    std::vector<mongo::BSONObj> toBSONObjs(unsigned int threads = 0) const;
+
     //--------------------------------------------------------------------------
 	//
 	// Export
@@ -97,6 +152,19 @@ public :
 	//! Populates Assimp's scene.
 	void toAssimp(aiScene *scene) const;
 
+	/*!
+	 * Populates Assimp's scene, copying the geometry of meshes one by one into
+	 * the aiScene and releasing it from each mesh straight away, see
+	 * RepoNodeMesh::moveToAssimp(). Only the mesh being copied is held twice.
+	 * Meshes without geometry are populated by the geometry loader, which may
+	 * fetch a whole batch of meshes at once, eg up to
+	 * MongoGeometryLoader::DEFAULT_BATCH_SIZE, or all of them if loading in
+	 * the background, so the peak is one such batch on top of the aiScene
+	 * built so far. Afterwards, the aiScene owns all of its arrays and the
+	 * meshes of this scene have no geometry.
+	 */
+	void moveToAssimp(aiScene *scene);
+
     //--------------------------------------------------------------------------
 	//
 	// Getters
@@ -148,6 +216,27 @@ public :
      */
     virtual void removeNodeRecursively(RepoNodeAbstract* node);
 
+protected :
+
+    /*!
+     * Converts the aiScene into this empty graph. If adopt is true, the
+     * aiMeshes are owned by the caller and handed over to the mesh nodes.
+     */
+    void populate(
+            const aiScene *scene,
+            const std::map<std::string, RepoNodeAbstract *> &textures,
+            unsigned int meshApi,
+            unsigned int threads,
+            bool adopt);
+
+    //! Populates Assimp's scene, moving mesh geometry if requested.
+    void populateAssimp(aiScene *scene, bool moveGeometry) const;
+
+    //! Empty graph with the given root, used by RepoSceneDecoder.
+    explicit RepoGraphScene(RepoNodeAbstract *root)
+        : RepoGraphAbstract(root)
+        , geometryLoader(NULL) {}
+
 protected :
 
     // TODO: The vectors should be lists or sets to prevent excessive copying!
@@ -166,6 +255,8 @@ protected :
 
     RepoNodeAbstractSet transformations; //!< Transformations
 
+    RepoGeometryLoader *geometryLoader; //!< Loader of mesh geometry, owned
+
 }; // end class
 
 } // end namespace core
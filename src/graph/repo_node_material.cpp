@@ -93,19 +93,7 @@ repo::core::RepoNodeMaterial::RepoNodeMaterial(
 	
     //--------------------------------------------------------------------------
 	// Texture (one diffuse for the moment)
-	// Textures are uniquely referenced by their name
-	aiString texPath; // contains a filename of a texture
-	if (AI_SUCCESS == material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath))
-	{
-		std::map<std::string, RepoNodeAbstract *>::const_iterator it = 
-			textures.find(texPath.data);
-
-		if (textures.end() != it)
-		{
-			this->addChild(it->second);
-			it->second->addParent(this);
-		}
-	}
+	attachTextures(material, textures);
 }
 
 //------------------------------------------------------------------------------
@@ -196,6 +184,32 @@ repo::core::RepoNodeMaterial::~RepoNodeMaterial()
 		delete specular;
 }
 
+//------------------------------------------------------------------------------
+//
+// Graph
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoNodeMaterial::attachTextures(
+	const aiMaterial *material,
+	const std::map<std::string, RepoNodeAbstract *> &textures)
+{
+	// Textures are uniquely referenced by their name
+	aiString texPath; // contains a filename of a texture
+	if (!textures.empty() &&
+		AI_SUCCESS == material->GetTexture(aiTextureType_DIFFUSE, 0, &texPath))
+	{
+		std::map<std::string, RepoNodeAbstract *>::const_iterator it = 
+			textures.find(texPath.data);
+
+		if (textures.end() != it)
+		{
+			this->addChild(it->second);
+			it->second->addParent(this);
+		}
+	}
+}
+
 //------------------------------------------------------------------------------
 //
 // Operators
@@ -108,6 +108,21 @@ public :
 	//! Destructor, deletes ambient, diffuse, emissive and specular colors
 	~RepoNodeMaterial();
 
+    //--------------------------------------------------------------------------
+	//
+	// Graph
+	//
+    //--------------------------------------------------------------------------
+
+	/*!
+	 * Makes the diffuse texture of the aiMaterial, if found among the
+	 * textures by name, a child of this material. Modifies the texture too,
+	 * so it must not be called concurrently for materials sharing textures.
+	 */
+	void attachTextures(
+        const aiMaterial *material,
+        const std::map<std::string, RepoNodeAbstract *> &textures);
+
     //--------------------------------------------------------------------------
     //
     // Operators
@@ -17,8 +17,11 @@
 
 
 #include "repo_node_mesh.h"
+#include "../conversion/repo_transcoder_mesh.h"
+#include "../compute/repo_sha256.h"
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
 
 //------------------------------------------------------------------------------
@@ -40,7 +43,17 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 			normals(NULL),
 			outline(NULL),
             uvChannels(NULL),
-            colors(NULL)
+            colors(NULL),
+            tangents(NULL),
+            bitangents(NULL),
+            boneInfluences(NULL),
+            uvChannelsCount(0),
+            colorSetsCount(0),
+            viewMode(false),
+            vectorsMaterialized(true),
+            geometryLoaded(true),
+            geometryLoader(NULL),
+            storedVerticesCount(0)
 {
     //--------------------------------------------------------------------------
 	// Vertices (always present)
@@ -50,17 +63,6 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 	vertices->insert(vertices->begin(),
 		mesh->mVertices, mesh->mVertices + mesh->mNumVertices);
 
-
-    //--------------------------------------------------------------------------
-	// Faces
-	if (mesh->HasFaces())
-	{
-		faces = new std::vector<aiFace>();
-		faces->reserve(mesh->mNumFaces);
-		faces->insert(faces->begin(),
-			mesh->mFaces, mesh->mFaces + mesh->mNumFaces);
-	}
-
     //--------------------------------------------------------------------------
 	// Normals
 	if (mesh->HasNormals())
@@ -71,46 +73,135 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 			mesh->mNormals, mesh->mNormals + mesh->mNumVertices);
 	}
 
+	initialize(mesh, materials);
+}
+
+repo::core::RepoNodeMesh::RepoNodeMesh(
+	const unsigned int api,
+	std::unique_ptr<aiMesh> mesh,
+	const std::vector<RepoNodeAbstract *> & materials) :
+		RepoNodeAbstract (
+			REPO_NODE_TYPE_MESH,
+			api,
+            boost::uuids::random_generator()(),
+			mesh->mName.data),
+			vertices(NULL),
+			faces(NULL),
+			normals(NULL),
+			outline(NULL),
+            uvChannels(NULL),
+            colors(NULL),
+            tangents(NULL),
+            bitangents(NULL),
+            boneInfluences(NULL),
+            uvChannelsCount(0),
+            colorSetsCount(0),
+            viewMode(false),
+            vectorsMaterialized(true),
+            geometryLoaded(true),
+            geometryLoader(NULL),
+            storedVerticesCount(0)
+{
+	initialize(mesh.get(), materials);
+
     //--------------------------------------------------------------------------
-	// Bones
-	/*
-	if (mesh->HasBones())
-	{
-	}
+	// Vertices and normals are adopted as they are, everything else has
+	// been converted so the rest of the aiMesh goes straight away.
+	viewMode = true;
+	vectorsMaterialized = false;
+
+	verticesView = RepoBinaryView<aiVector3D>(
+		mesh->mVertices, mesh->mVertices ? mesh->mNumVertices : 0);
+	mesh->mVertices = NULL;
+
+	if (mesh->HasNormals())
+		normalsView = RepoBinaryView<aiVector3D>(
+			mesh->mNormals, mesh->mNumVertices);
+	mesh->mNormals = NULL;
 
+	uvChannelsView = RepoBinaryView<aiVector2D>(uvChannels);
 
-	if (mesh->HasPositions())
+	mesh.reset();
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::RepoNodeMesh::initialize(
+	const aiMesh *mesh,
+	const std::vector<RepoNodeAbstract *> & materials)
+{
+    //--------------------------------------------------------------------------
+	// Faces
+	if (mesh->HasFaces())
 	{
+		faces = new RepoFaceBuffer(mesh->mFaces, mesh->mNumFaces);
 
+		// Triangles only API levels cannot represent other primitives
+		if ((REPO_NODE_API_LEVEL_2 == this->api ||
+			 REPO_NODE_API_LEVEL_3 == this->api) && !faces->isTriangles())
+			this->api = REPO_NODE_API_LEVEL_1;
 	}
 
+    //--------------------------------------------------------------------------
+	// Tangents and bitangents
 	if (mesh->HasTangentsAndBitangents())
 	{
+		tangents = new std::vector<aiVector3t<float> >(
+			mesh->mTangents, mesh->mTangents + mesh->mNumVertices);
+		bitangents = new std::vector<aiVector3t<float> >(
+			mesh->mBitangents, mesh->mBitangents + mesh->mNumVertices);
+	}
 
-	}*/
+    //--------------------------------------------------------------------------
+	// Bones, weights are packed into the four largest influences per vertex
+	if (mesh->HasBones())
+	{
+		for (unsigned int b = 0; b < mesh->mNumBones &&
+			 b < RepoTranscoderMesh::BONES_COUNT_LIMIT; ++b)
+		{
+			Bone bone;
+			bone.name = mesh->mBones[b]->mName.data;
+			bone.offsetMatrix = mesh->mBones[b]->mOffsetMatrix;
+			bones.push_back(bone);
+		}
+		boneInfluences = new std::vector<uint8_t>(
+			RepoTranscoderMesh::encodeBoneWeights(
+				mesh->mBones, mesh->mNumBones, mesh->mNumVertices));
+	}
 
     //--------------------------------------------------------------------------
 	// UV channels
-	// Copies only the very first UV channel over
+	// All channels concatenated in 2D, W of 3D texture coordinates is lost.
 	// TODO: make sure enough memory can be allocated
-	// TODO: add support for all UV channels.
-	if (mesh->HasTextureCoords(0))
+	while (uvChannelsCount < AI_MAX_NUMBER_OF_TEXTURECOORDS &&
+		   mesh->HasTextureCoords(uvChannelsCount))
+		++uvChannelsCount;
+	if (uvChannelsCount > 0)
 	{
-		uvChannels = new std::vector<std::vector<aiVector3t<float>> * >();
-		uvChannels->push_back(new std::vector<aiVector3t<float>>());
-		uvChannels->at(0)->reserve(mesh->mNumVertices);
-
-		uvChannels->at(0)->insert(uvChannels->at(0)->begin(),
-		mesh->mTextureCoords[0], mesh->mTextureCoords[0] + mesh->mNumVertices);
+		uvChannels = new std::vector<aiVector2t<float> >(
+			uvChannelsCount * mesh->mNumVertices);
+		for (unsigned int c = 0; c < uvChannelsCount; ++c)
+		{
+			const aiVector3D *texCoords = mesh->mTextureCoords[c];
+			aiVector2t<float> *channel = &(*uvChannels)[c * mesh->mNumVertices];
+			for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+				channel[i] = aiVector2t<float>(texCoords[i].x, texCoords[i].y);
+			uvComponents.push_back(1 == mesh->mNumUVComponents[c] ? 1 : 2);
+		}
 	}
 
-    // Consider only first color set
-    if (mesh->HasVertexColors(0))
+    //--------------------------------------------------------------------------
+	// Vertex colors, all sets concatenated
+	while (colorSetsCount < AI_MAX_NUMBER_OF_COLOR_SETS &&
+		   mesh->HasVertexColors(colorSetsCount))
+		++colorSetsCount;
+	if (colorSetsCount > 0)
 	{
         colors = new std::vector<aiColor4t<float>>();
-        colors->reserve(mesh->mNumVertices);
-        colors->insert(colors->begin(),
-            mesh->mColors[0], mesh->mColors[0] + mesh->mNumVertices);
+        colors->reserve(colorSetsCount * mesh->mNumVertices);
+		for (unsigned int c = 0; c < colorSetsCount; ++c)
+			colors->insert(colors->end(),
+				mesh->mColors[c], mesh->mColors[c] + mesh->mNumVertices);
     }
 
     //--------------------------------------------------------------------------
@@ -140,17 +231,142 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 //------------------------------------------------------------------------------
 
 repo::core::RepoNodeMesh::RepoNodeMesh(
-	const mongo::BSONObj &obj) : RepoNodeAbstract(obj),
+	const mongo::BSONObj &obj,
+    bool view) : RepoNodeAbstract(obj),
 		vertices(NULL),
 		faces(NULL),
 		normals(NULL),
 		outline(NULL),
         uvChannels(NULL),
-        colors(NULL)
+        colors(NULL),
+        tangents(NULL),
+        bitangents(NULL),
+        boneInfluences(NULL),
+        uvChannelsCount(0),
+        colorSetsCount(0),
+        viewMode(false),
+        vectorsMaterialized(true),
+        geometryLoaded(true),
+        geometryLoader(NULL),
+        storedVerticesCount(0)
 {
+    //--------------------------------------------------------------------------
+    // Vertices, faces, normals and UV channels
+    setGeometry(obj, view);
+
+    //--------------------------------------------------------------------------
+    // Geometry fields have been projected out, see getGeometryFields()
+    if (obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT) &&
+        !obj.hasField(REPO_NODE_LABEL_VERTICES))
+        geometryLoaded = false;
+    if (obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
+        storedVerticesCount =
+                obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
+
+    //--------------------------------------------------------------------------
+	// Polygon mesh outline (2D bounding rectangle in XY for the moment)
+	//
+    if (obj.hasField(REPO_NODE_LABEL_OUTLINE))
+    {
+        //outline = new std::vector<aiVector2D>();
+        // TODO: fill in
+    }
+
+    //--------------------------------------------------------------------------
+	// Bounding box
+    if (obj.hasField(REPO_NODE_LABEL_BOUNDING_BOX))
+    {
+		std::pair<aiVector3D, aiVector3D> min_max = RepoTranscoderBSON::retrieveBBox(
+            obj.getField(REPO_NODE_LABEL_BOUNDING_BOX));
+
+		this->boundingBox.setMin(min_max.first);
+		this->boundingBox.setMax(min_max.second);
+    }
+    else if (geometryLoaded)
+        boundingBox = RepoBoundingBox(getVertexAttributes(
+            RepoVertexAttributes::getMask(RepoVertexAttributes::POSITION)));
+
+
+
+    //--------------------------------------------------------------------------
+    // SHA-256 hash, trusted only if calculated the same way as now
+    if (obj.hasField(REPO_NODE_LABEL_SHA256) &&
+        mongo::String == obj.getField(REPO_NODE_LABEL_SHA256).type() &&
+        obj.hasField(REPO_NODE_LABEL_SHA256_SCHEME) &&
+        REPO_VERTEX_HASH_SCHEME ==
+            obj.getField(REPO_NODE_LABEL_SHA256_SCHEME).numberInt())
+        vertexHash = obj.getField(REPO_NODE_LABEL_SHA256).str();
+}
+
+//------------------------------------------------------------------------------
+//
+// Destructor
+//
+//------------------------------------------------------------------------------
+repo::core::RepoNodeMesh::~RepoNodeMesh()
+{
+    clearGeometry();
+
+	if (NULL != outline)
+	{
+		outline->clear();
+		delete outline;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+// Geometry
+//
+//------------------------------------------------------------------------------
+void repo::core::RepoNodeMesh::setGeometry(
+        const mongo::BSONObj &obj,
+        bool view)
+{
+    clearGeometry();
+
+    //--------------------------------------------------------------------------
+    // Compressed geometry has to be decoded, there is nothing to borrow
+    bool compressed = REPO_NODE_API_LEVEL_3 == api;
+    if (compressed)
+    {
+        view = false;
+        retrieveCompressedGeometry(obj);
+    }
+
+    //--------------------------------------------------------------------------
+    // View mode borrows vertices, normals and UV channels from the buffer,
+    // faces are always decoded.
+    if (view)
+    {
+        viewMode = true;
+        vectorsMaterialized = false;
+
+        unsigned int verticesCount =
+                obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
+        if (obj.hasField(REPO_NODE_LABEL_VERTICES))
+            verticesView = RepoTranscoderBSON::retrieveView<aiVector3D>(
+                        obj, REPO_NODE_LABEL_VERTICES, verticesCount);
+        if (obj.hasField(REPO_NODE_LABEL_NORMALS))
+            normalsView = RepoTranscoderBSON::retrieveView<aiVector3D>(
+                        obj, REPO_NODE_LABEL_NORMALS, verticesCount);
+        if (!obj.hasField(REPO_NODE_LABEL_VERTEX_CHANNELS) &&
+            obj.hasField(REPO_NODE_LABEL_UV_CHANNELS) &&
+            obj.hasField(REPO_NODE_LABEL_UV_CHANNELS_COUNT))
+        {
+            uvChannelsCount =
+                    obj.getField(REPO_NODE_LABEL_UV_CHANNELS_COUNT).numberInt();
+            uvChannelsView = RepoTranscoderBSON::retrieveView<aiVector2D>(
+                        obj,
+                        REPO_NODE_LABEL_UV_CHANNELS,
+                        uvChannelsCount * verticesCount);
+        }
+    }
+
     //--------------------------------------------------------------------------
 	// Vertices
-	if (obj.hasField(REPO_NODE_LABEL_VERTICES) &&
+	if (!view && !compressed &&
+        obj.hasField(REPO_NODE_LABEL_VERTICES) &&
 		obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
 	{
 		vertices = new std::vector<aiVector3t<float>>();
@@ -166,7 +382,7 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 		obj.hasField(REPO_NODE_LABEL_FACES_COUNT) &&
 		obj.hasField(REPO_NODE_LABEL_FACES_BYTE_COUNT))
 	{
-		faces = new std::vector<aiFace>();
+		faces = new RepoFaceBuffer();
 		retrieveFacesArray(
 			obj.getField(REPO_NODE_LABEL_FACES),
 			api,
@@ -177,7 +393,8 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 
     //--------------------------------------------------------------------------
 	// Normals
-	if (obj.hasField(REPO_NODE_LABEL_NORMALS) &&
+	if (!view && !compressed &&
+        obj.hasField(REPO_NODE_LABEL_NORMALS) &&
 		obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
 	{
         normals = new std::vector<aiVector3t<float> >();
@@ -188,123 +405,251 @@ repo::core::RepoNodeMesh::RepoNodeMesh(
 	}
 
     //--------------------------------------------------------------------------
-	// Polygon mesh outline (2D bounding rectangle in XY for the moment)
-	//
-    if (obj.hasField(REPO_NODE_LABEL_OUTLINE))
-    {
-        //outline = new std::vector<aiVector2D>();
-        // TODO: fill in
-    }
+	// UV channels and colors
+	if (obj.hasField(REPO_NODE_LABEL_VERTEX_CHANNELS) &&
+		obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
+		retrieveVertexChannels(obj, view);
+	else if (!view &&
+        obj.hasField(REPO_NODE_LABEL_UV_CHANNELS) &&
+		obj.hasField(REPO_NODE_LABEL_UV_CHANNELS_BYTE_COUNT) &&
+		obj.hasField(REPO_NODE_LABEL_UV_CHANNELS_COUNT))
+	{
+		// Channels stay concatenated in 2D as stored
+		uvChannelsCount =
+			obj.getField(REPO_NODE_LABEL_UV_CHANNELS_COUNT).numberInt();
+		uvChannels = new std::vector<aiVector2t<float> >();
+		RepoTranscoderBSON::retrieve(
+			obj.getField(REPO_NODE_LABEL_UV_CHANNELS),
+			uvChannelsCount *
+				obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt(),
+			uvChannels);
+	}
 
     //--------------------------------------------------------------------------
-	// Bounding box
-    if (obj.hasField(REPO_NODE_LABEL_BOUNDING_BOX))
-    {
-		std::pair<aiVector3D, aiVector3D> min_max = RepoTranscoderBSON::retrieveBBox(
-            obj.getField(REPO_NODE_LABEL_BOUNDING_BOX));
+	// Single color set as an array of RGBA arrays, unless in vertex channels
+	if (!obj.hasField(REPO_NODE_LABEL_VERTEX_CHANNELS) &&
+		mongo::Array == obj.getField(REPO_NODE_LABEL_COLORS).type())
+	{
+		std::vector<mongo::BSONElement> array =
+			obj.getField(REPO_NODE_LABEL_COLORS).Array();
+		colors = new std::vector<aiColor4D>(array.size());
+		for (size_t i = 0; i < array.size(); ++i)
+			(*colors)[i] = RepoTranscoderBSON::retrieveRGBA(array[i]);
+		colorSetsCount = colors->empty() ? 0 : 1;
+	}
 
-		this->boundingBox.setMin(min_max.first);
-		this->boundingBox.setMax(min_max.second);
-    }
+    //--------------------------------------------------------------------------
+	// Tangents and bones, always decoded
+	retrieveTangentsAndBones(obj, compressed);
 
+    geometryLoaded = true;
+}
 
+void repo::core::RepoNodeMesh::retrieveCompressedGeometry(
+        const mongo::BSONObj &obj)
+{
+    if (!obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
+        return;
+    size_t verticesCount =
+            obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
 
     //--------------------------------------------------------------------------
-    // SHA-256 hash
-    if (obj.hasField(REPO_NODE_LABEL_SHA256))
+    // Vertices are quantized within the bounding box which is read here as
+    // the constructor retrieves it only after the geometry.
+    mongo::BSONElement bse = obj.getField(REPO_NODE_LABEL_VERTICES);
+    if (mongo::BinData == bse.type() &&
+        obj.hasField(REPO_NODE_LABEL_BOUNDING_BOX))
     {
-        vertexHash = obj.getField(REPO_NODE_LABEL_SHA256).numberInt();
+        std::pair<aiVector3D, aiVector3D> minMax =
+                RepoTranscoderBSON::retrieveBBox(
+                    obj.getField(REPO_NODE_LABEL_BOUNDING_BOX));
+        int len = 0;
+        const char *binData = bse.binData(len);
+        std::vector<uint16_t> quantized;
+        if (RepoTranscoderMesh::unpack(
+                    binData, std::max(len, 0), verticesCount * 3, quantized) &&
+            quantized.size() == verticesCount * 3)
+        {
+            vertices = new std::vector<aiVector3t<float> >();
+            RepoTranscoderMesh::dequantizePositions(
+                        quantized.data(),
+                        verticesCount,
+                        minMax.first,
+                        minMax.second,
+                        *vertices);
+        }
     }
 
     //--------------------------------------------------------------------------
-	// UV channels
-	if (obj.hasField(REPO_NODE_LABEL_UV_CHANNELS) &&
-		obj.hasField(REPO_NODE_LABEL_UV_CHANNELS_BYTE_COUNT) &&
-		obj.hasField(REPO_NODE_LABEL_UV_CHANNELS_COUNT))
-	{
-		unsigned int numberOfConcatenatedEntries =
-			obj.getField(REPO_NODE_LABEL_UV_CHANNELS_COUNT).numberInt() *
-			obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
+    // Normals
+    bse = obj.getField(REPO_NODE_LABEL_NORMALS);
+    if (mongo::BinData == bse.type())
+    {
+        int len = 0;
+        const char *binData = bse.binData(len);
+        std::vector<int16_t> encoded;
+        if (RepoTranscoderMesh::unpack(
+                    binData, std::max(len, 0), verticesCount * 2, encoded) &&
+            encoded.size() == verticesCount * 2)
+        {
+            normals = new std::vector<aiVector3t<float> >();
+            RepoTranscoderMesh::decodeNormals(
+                        encoded.data(), verticesCount, *normals);
+        }
+    }
+}
 
-		std::vector<aiVector2t<float>> concatenated;
-		RepoTranscoderBSON::retrieve(
-			obj.getField(REPO_NODE_LABEL_UV_CHANNELS),
-			numberOfConcatenatedEntries,
-			&concatenated);
+std::list<std::string> repo::core::RepoNodeMesh::getGeometryFields()
+{
+    std::list<std::string> fields;
+    fields.push_back(REPO_NODE_LABEL_VERTICES);
+    fields.push_back(REPO_NODE_LABEL_FACES);
+    fields.push_back(REPO_NODE_LABEL_NORMALS);
+    fields.push_back(REPO_NODE_LABEL_UV_CHANNELS);
+    fields.push_back(REPO_NODE_LABEL_COLORS);
+    fields.push_back(REPO_NODE_LABEL_VERTEX_CHANNELS);
+    fields.push_back(REPO_NODE_LABEL_TANGENT_FRAMES);
+    fields.push_back(REPO_NODE_LABEL_BONES);
+    fields.push_back(REPO_NODE_LABEL_BONE_INFLUENCES);
+    return fields;
+}
 
-		unsigned int channelsCount =
-			obj.getField(REPO_NODE_LABEL_UV_CHANNELS_COUNT).numberInt();
+repo::core::RepoBinaryView<aiVector2D> repo::core::RepoNodeMesh::getUVChannelView(
+        unsigned int channel) const
+{
+    ensureGeometry();
+    RepoBinaryView<aiVector2D> view;
+    if (channel < uvChannelsCount)
+    {
+        RepoBinaryView<aiVector2D> channels = getUVChannelsView();
+        size_t channelSize = channels.size() / uvChannelsCount;
+        view = channels.slice(channel * channelSize, channelSize);
+    }
+    return view;
+}
 
-        unsigned int channelSize = (unsigned int) concatenated.size()/channelsCount;
-		uvChannels =
-			new std::vector<std::vector<aiVector3t<float>> *>(channelsCount);
+repo::core::RepoBinaryView<aiColor4D> repo::core::RepoNodeMesh::getColorSetView(
+        unsigned int set) const
+{
+    ensureGeometry();
+    RepoBinaryView<aiColor4D> view;
+    if (set < colorSetsCount && colors)
+    {
+        size_t setSize = colors->size() / colorSetsCount;
+        view = RepoBinaryView<aiColor4D>(colors).slice(set * setSize, setSize);
+    }
+    return view;
+}
 
-		// For every uv channel present (usually only one)
-		for (unsigned int i = 0; i < channelsCount; ++i)
-		{
-			uvChannels->at(i) = new std::vector<aiVector3t<float>>();
-			uvChannels->at(i)->reserve(channelSize);
+repo::core::RepoVertexAttributes repo::core::RepoNodeMesh::getVertexAttributes(
+        unsigned int attributes,
+        RepoVertexAttributes::Layout layout) const
+{
+    RepoBinaryView<aiVector3D> verticesData = getVerticesView();
+    RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+    size_t verticesCount = verticesData.size();
 
-			// Copy over all per vertex UV values
-			for (unsigned int j = 0; j < channelSize; ++j)
-			{
-				aiVector2t<float> uv = concatenated[(i * channelSize) + j];
-				uvChannels->at(i)->push_back(aiVector3t<float>(uv.x, uv.y, 0));
-			}
-		}
-	}
+    //--------------------------------------------------------------------------
+    // Leave out attributes which are not present for every vertex
+    if (normalsData.size() != verticesCount)
+        attributes &= ~RepoVertexAttributes::getMask(RepoVertexAttributes::NORMAL);
+    RepoBinaryView<aiColor4D> colorsData = getColorSetView(0);
+    if (colorsData.size() != verticesCount)
+        attributes &= ~RepoVertexAttributes::getMask(RepoVertexAttributes::COLOR);
+    for (unsigned int i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+        if (getUVChannelView(i).size() != verticesCount)
+            attributes &= ~RepoVertexAttributes::getMask(
+                        RepoVertexAttributes::getUVChannel(i));
+
+    //--------------------------------------------------------------------------
+    RepoVertexAttributes vertexAttributes(verticesCount, attributes, layout);
+    vertexAttributes.assign(RepoVertexAttributes::POSITION, verticesData);
+    vertexAttributes.assign(RepoVertexAttributes::NORMAL, normalsData);
+    vertexAttributes.assign(RepoVertexAttributes::COLOR, colorsData);
+    for (unsigned int i = 0; i < uvChannelsCount &&
+         i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+        vertexAttributes.assign(
+                    RepoVertexAttributes::getUVChannel(i),
+                    getUVChannelView(i));
+    return vertexAttributes;
 }
 
-//------------------------------------------------------------------------------
-//
-// Destructor
-//
-//------------------------------------------------------------------------------
-repo::core::RepoNodeMesh::~RepoNodeMesh()
+void repo::core::RepoNodeMesh::materializeVectors()
+{
+    std::unique_lock<std::mutex> lock(vectorsMutex);
+    if (vectorsMaterialized)
+        return;
+
+    if (!verticesView.empty())
+        vertices = verticesView.toVector();
+    if (!normalsView.empty())
+        normals = normalsView.toVector();
+    vectorsMaterialized = true;
+}
+
+void repo::core::RepoNodeMesh::clearGeometry()
 {
 	if (NULL != vertices)
 	{
 		vertices->clear();
 		delete vertices;
+        vertices = NULL;
 	}
 
 	if (NULL != faces)
 	{
 		faces->clear();
 		delete faces;
+        faces = NULL;
 	}
 
 	if (NULL != normals)
 	{
 		normals->clear();
 		delete normals;
-	}
-
-	if (NULL != outline)
-	{
-		outline->clear();
-		delete outline;
+        normals = NULL;
 	}
 
 	if (NULL != uvChannels)
 	{
-
-        std::vector<std::vector<aiVector3t<float>>*>::iterator it;
-        for (it = uvChannels->begin(); it != uvChannels->end(); ++it)
-        {
-            std::vector<aiVector3t<float>> *channel = *it;
-			channel->clear();
-			delete channel;
-			channel = NULL;
-		}
 		uvChannels->clear();
+        delete uvChannels;
 		uvChannels = NULL;
 	}
 
     if (NULL != colors){
         colors->clear();
         delete colors;
+        colors = NULL;
+    }
+
+    if (NULL != tangents)
+    {
+        delete tangents;
+        tangents = NULL;
+    }
+
+    if (NULL != bitangents)
+    {
+        delete bitangents;
+        bitangents = NULL;
+    }
+
+    if (NULL != boneInfluences)
+    {
+        delete boneInfluences;
+        boneInfluences = NULL;
     }
+    bones.clear();
+
+    verticesView = RepoBinaryView<aiVector3D>();
+    normalsView = RepoBinaryView<aiVector3D>();
+    uvChannelsView = RepoBinaryView<aiVector2D>();
+    uvChannelsCount = 0;
+    uvComponents.clear();
+    colorSetsCount = 0;
+    viewMode = false;
+    vectorsMaterialized = true;
 }
 
 //------------------------------------------------------------------------------
@@ -321,9 +666,7 @@ bool repo::core::RepoNodeMesh::operator==(const RepoNodeAbstract& other) const
             (std::equal(this->getVertices()->begin(),
                         this->getVertices()->end(),
                         otherMesh->getVertices()->end())) &&
-            (std::equal(this->getFaces()->begin(),
-                        this->getFaces()->end(),
-                        otherMesh->getFaces()->end())) &&
+            (*this->getFaces() == *otherMesh->getFaces()) &&
             (std::equal(this->getNormals()->begin(),
                         this->getNormals()->end(),
                         otherMesh->getNormals()->end())) &&
@@ -334,15 +677,12 @@ bool repo::core::RepoNodeMesh::operator==(const RepoNodeAbstract& other) const
             (std::equal(this->getColors()->begin(),
                         this->getColors()->end(),
                         otherMesh->getColors()->begin())) &&
-            (std::equal(this->getUVChannel(0)->begin(),
-                        this->getUVChannel(0)->end(),
-                        otherMesh->getUVChannel(0)->begin())) &&
-            (std::equal(this->getUVChannel(1)->begin(),
-                        this->getUVChannel(1)->end(),
-                        otherMesh->getUVChannel(1)->end())) &&
-            (std::equal(this->getUVChannel(2)->begin(),
-                        this->getUVChannel(2)->end(),
-                        otherMesh->getUVChannel(2)->end()));
+            (this->getUVChannelsCount() == otherMesh->getUVChannelsCount()) &&
+            (this->getUVChannelsView().size() ==
+                otherMesh->getUVChannelsView().size()) &&
+            (std::equal(this->getUVChannelsView().begin(),
+                        this->getUVChannelsView().end(),
+                        otherMesh->getUVChannelsView().begin()));
 }
 
 //------------------------------------------------------------------------------
@@ -354,53 +694,82 @@ mongo::BSONObj repo::core::RepoNodeMesh::toBSONObj() const
 {
 	mongo::BSONObjBuilder builder;
 
+    ensureGeometry();
+
     //--------------------------------------------------------------------------
 	// Compulsory fields such as _id, type, api as well as path
 	// and optional name
 	appendDefaultFields(builder);
 
+    //--------------------------------------------------------------------------
+    // Compressed geometry replaces vertices, faces, normals, colors and uvs
+    bool compressed = REPO_NODE_API_LEVEL_3 == api &&
+            (NULL == faces || faces->empty() || faces->isTriangles());
+    if (compressed)
+        appendCompressedGeometry(builder);
+
     //--------------------------------------------------------------------------
 	// Vertices
-	if (NULL != vertices && vertices->size() > 0)
+    RepoBinaryView<aiVector3D> verticesData = getVerticesView();
+	if (!compressed && verticesData.size() > 0)
 		RepoTranscoderBSON::append(
 			REPO_NODE_LABEL_VERTICES,
-			vertices,
+			verticesData,
 			builder,
 			REPO_NODE_LABEL_VERTICES_BYTE_COUNT,
 			REPO_NODE_LABEL_VERTICES_COUNT);
 
     //--------------------------------------------------------------------------
 	// Faces
-	if (NULL != faces && faces->size() > 0)
+	if (!compressed && NULL != faces && faces->size() > 0)
 	{
 		builder << REPO_NODE_LABEL_FACES_COUNT << (unsigned int) (faces->size());
 
-		// In API LEVEL 1, faces are stored as
-		// [n1, v1, v2, ..., n2, v1, v2...]
-		std::vector<unsigned int> facesLevel1;
-		for (unsigned int f = 0; f < faces->size(); ++f)
+		if (REPO_NODE_API_LEVEL_2 == api && faces->isTriangles())
 		{
-			aiFace face = (*faces)[f];
-			facesLevel1.push_back(face.mNumIndices);
-			for (unsigned int i = 0; i < face.mNumIndices; ++i)
-				facesLevel1.push_back(face.mIndices[i]);
+			// In API LEVEL 2, faces are stored as
+			// [v1, v2, v3, v1, v2, v3...] in 16 bits if possible
+			if (faces->isShortIndexable())
+			{
+				std::vector<uint16_t> facesLevel2(
+					faces->getIndices().begin(), faces->getIndices().end());
+				RepoTranscoderBSON::append(
+					REPO_NODE_LABEL_FACES,
+					&facesLevel2,
+					builder,
+					REPO_NODE_LABEL_FACES_BYTE_COUNT);
+			}
+			else
+				RepoTranscoderBSON::append(
+					REPO_NODE_LABEL_FACES,
+					&faces->getIndices(),
+					builder,
+					REPO_NODE_LABEL_FACES_BYTE_COUNT);
+		}
+		else
+		{
+			// In API LEVEL 1, faces are stored as
+			// [n1, v1, v2, ..., n2, v1, v2...]
+			std::vector<uint32_t> facesLevel1;
+			faces->toSerialized(facesLevel1);
+
+			RepoTranscoderBSON::append(
+				REPO_NODE_LABEL_FACES,
+				&facesLevel1,
+				builder,
+				REPO_NODE_LABEL_FACES_BYTE_COUNT);
 		}
-
-		RepoTranscoderBSON::append(
-			REPO_NODE_LABEL_FACES,
-			&facesLevel1,
-			builder,
-			REPO_NODE_LABEL_FACES_BYTE_COUNT);
 	}
 
     //--------------------------------------------------------------------------
 	// Normals
 	// TODO: modify so that the empty string does not need to be passed in.
 	// If "" is not used, this method calls the most generict append(T) method!
-	if (NULL != normals && normals->size() > 0)
+    RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+	if (!compressed && normalsData.size() > 0)
 		RepoTranscoderBSON::append(
 			REPO_NODE_LABEL_NORMALS,
-			normals,
+			normalsData,
 			builder,
 			"");
 
@@ -412,11 +781,12 @@ mongo::BSONObj repo::core::RepoNodeMesh::toBSONObj() const
 		builder);
 
     //--------------------------------------------------------------------------
-    // SHA-256 hash
-    if (!vertexHash.empty())
+    // SHA-256 hash along with its scheme, only if calculated beforehand,
+    // see RepoGraphScene::toBSONObjs()
+    if (verticesData.size() > 0 && hasVertexHash())
     {
-		// TODO: Fix this call - needs to be fixed as int conversion is overloaded
-		//builder << REPO_NODE_LABEL_SHA256 << (long unsigned int)(vertexHash);
+        builder << REPO_NODE_LABEL_SHA256 << vertexHash;
+        builder << REPO_NODE_LABEL_SHA256_SCHEME << REPO_VERTEX_HASH_SCHEME;
     }
 
     //--------------------------------------------------------------------------
@@ -428,109 +798,584 @@ mongo::BSONObj repo::core::RepoNodeMesh::toBSONObj() const
 			builder);
 
     //--------------------------------------------------------------------------
-	// TODO: bi/tangents, vertex colors
+	// UV channels, vertex colors, tangents and bones
+    if (!compressed)
+    {
+        // Already concatenated, either owned or borrowed, compressed ones
+        // are appended along with the rest of the compressed geometry
+        appendLegacyVertexChannels(builder);
+        if (colorSetsCount > 1 ||
+            uvComponents.end() !=
+                std::find(uvComponents.begin(), uvComponents.end(), 1u))
+            appendVertexChannels(
+                        getUVChannelsView(),
+                        RepoBinaryView<aiColor4D>(colors),
+                        getVerticesView().size(),
+                        builder);
+        appendTangentsAndBones(NULL, builder);
+    }
+
+
+	return builder.obj();
+}
+
+void repo::core::RepoNodeMesh::appendCompressedGeometry(
+        mongo::BSONObjBuilder &builder) const
+{
+    RepoBinaryView<aiVector3D> verticesData = getVerticesView();
+    RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+    size_t verticesCount = verticesData.size();
 
     //--------------------------------------------------------------------------
-    // Vertex colors
-    if (colors && colors->size())
+    // Triangles are reordered for the vertex cache, vertices by their first
+    // use so that consecutive indices differ only a little.
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> order;
+    if (NULL != faces && !faces->empty())
+    {
+        indices = RepoTranscoderMesh::optimizeVertexCache(
+                    faces->getIndices(), verticesCount);
+        order = RepoTranscoderMesh::getFirstUseOrder(indices, verticesCount);
+        for (size_t i = 0; i < indices.size(); ++i)
+            if (indices[i] < verticesCount)
+                indices[i] = order[indices[i]];
+    }
+    else
+    {
+        order.resize(verticesCount);
+        for (size_t i = 0; i < verticesCount; ++i)
+            order[i] = (uint32_t) i;
+    }
+
+    //--------------------------------------------------------------------------
+    // Vertices
+    if (verticesCount > 0)
+    {
+        std::vector<aiVector3D> reordered(verticesCount);
+        for (size_t i = 0; i < verticesCount; ++i)
+            reordered[order[i]] = verticesData[i];
+
+        std::vector<uint8_t> packed = RepoTranscoderMesh::pack(
+                    RepoTranscoderMesh::quantizePositions(
+                        RepoBinaryView<aiVector3D>(&reordered),
+                        boundingBox.getMin(),
+                        boundingBox.getMax()));
+        builder << REPO_NODE_LABEL_VERTICES_COUNT << (unsigned int) verticesCount;
         RepoTranscoderBSON::append(
-                    REPO_NODE_LABEL_COLORS,
-                    *colors,
-                    builder);
+                    REPO_NODE_LABEL_VERTICES,
+                    &packed,
+                    builder,
+                    REPO_NODE_LABEL_VERTICES_BYTE_COUNT);
+    }
 
     //--------------------------------------------------------------------------
-	// UV channels
-	if (NULL != uvChannels && uvChannels->size() > 0)
-	{
-		// Could be unsigned __int64 if BSON had such construct (the closest is only __int64)
-		builder << REPO_NODE_LABEL_UV_CHANNELS_COUNT << (unsigned int)(uvChannels->size());
+    // Faces
+    if (!indices.empty())
+    {
+        std::vector<uint8_t> packed = RepoTranscoderMesh::pack(
+                    RepoTranscoderMesh::encodeIndices(indices));
+        builder << REPO_NODE_LABEL_FACES_COUNT << (unsigned int) (faces->size());
+        RepoTranscoderBSON::append(
+                    REPO_NODE_LABEL_FACES,
+                    &packed,
+                    builder,
+                    REPO_NODE_LABEL_FACES_BYTE_COUNT);
+    }
 
-		std::vector<aiVector2t<float>> concatenated;
+    //--------------------------------------------------------------------------
+    // Normals
+    if (verticesCount > 0 && normalsData.size() == verticesCount)
+    {
+        std::vector<aiVector3D> reordered(verticesCount);
+        for (size_t i = 0; i < verticesCount; ++i)
+            reordered[order[i]] = normalsData[i];
+
+        std::vector<uint8_t> packed = RepoTranscoderMesh::pack(
+                    RepoTranscoderMesh::encodeNormals(
+                        RepoBinaryView<aiVector3D>(&reordered)));
+        RepoTranscoderBSON::append(REPO_NODE_LABEL_NORMALS, &packed, builder, "");
+    }
 
-        std::vector<std::vector<aiVector3t<float>>*>::iterator it;
-        for (it = uvChannels->begin(); it != uvChannels->end(); ++it)
+    //--------------------------------------------------------------------------
+    // UV channels and vertex colors, reordered as the vertices
+    RepoBinaryView<aiVector2D> uvChannelsData = getUVChannelsView();
+    std::vector<aiVector2t<float> > reorderedUVs;
+    if (verticesCount > 0 &&
+        uvChannelsCount > 0 &&
+        uvChannelsData.size() == uvChannelsCount * verticesCount)
+    {
+        reorderedUVs.resize(uvChannelsData.size());
+        for (size_t c = 0; c < uvChannelsCount; ++c)
+            for (size_t i = 0; i < verticesCount; ++i)
+                reorderedUVs[c * verticesCount + order[i]] =
+                        uvChannelsData[c * verticesCount + i];
+    }
+
+    std::vector<aiColor4D> reorderedColors;
+    if (verticesCount > 0 &&
+        colors &&
+        colors->size() == colorSetsCount * verticesCount)
+    {
+        reorderedColors.resize(colors->size());
+        for (size_t c = 0; c < colorSetsCount; ++c)
+            for (size_t i = 0; i < verticesCount; ++i)
+                reorderedColors[c * verticesCount + order[i]] =
+                        (*colors)[c * verticesCount + i];
+    }
+
+    appendVertexChannels(
+                RepoBinaryView<aiVector2D>(&reorderedUVs),
+                RepoBinaryView<aiColor4D>(&reorderedColors),
+                verticesCount,
+                builder);
+
+    //--------------------------------------------------------------------------
+    // Tangents and bones
+    appendTangentsAndBones(&order, builder);
+}
+
+void repo::core::RepoNodeMesh::appendTangentsAndBones(
+        const std::vector<uint32_t> *order,
+        mongo::BSONObjBuilder &builder) const
+{
+    size_t verticesCount = getVerticesView().size();
+    if (0 == verticesCount || (order && order->size() != verticesCount))
+        return;
+
+    //--------------------------------------------------------------------------
+    // Tangent frames, u and v of tangents followed by their handedness,
+    // bitangents are reconstructed from the normals
+    RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+    if (tangents && bitangents &&
+        tangents->size() == verticesCount &&
+        bitangents->size() == verticesCount &&
+        normalsData.size() == verticesCount)
+    {
+        std::vector<int16_t> encoded = RepoTranscoderMesh::encodeTangents(
+                    normalsData,
+                    RepoBinaryView<aiVector3D>(tangents),
+                    RepoBinaryView<aiVector3D>(bitangents));
+
+        if (order)
         {
-            std::vector<aiVector3t<float>> *channel = *it;
+            std::vector<int16_t> reordered(encoded.size());
+            for (size_t c = 0; c < 3; ++c)
+                for (size_t i = 0; i < verticesCount; ++i)
+                    reordered[c * verticesCount + (*order)[i]] =
+                            encoded[c * verticesCount + i];
+            std::vector<uint8_t> packed = RepoTranscoderMesh::pack(reordered);
+            RepoTranscoderBSON::append(
+                        REPO_NODE_LABEL_TANGENT_FRAMES, &packed, builder, "");
+        }
+        else
+            RepoTranscoderBSON::append(
+                        REPO_NODE_LABEL_TANGENT_FRAMES, &encoded, builder, "");
+    }
 
-             std::vector<aiVector3t<float>>::iterator cit;
-             for (cit = channel->begin(); cit != channel->end(); ++cit)
-             {
+    //--------------------------------------------------------------------------
+    // Bones
+    if (bones.empty())
+        return;
 
-                const aiVector3t<float> uv = *cit;
-//		for each (std::vector<aiVector3t<float>> * channel in *uvChannels)
-//			for each (const aiVector3t<float> &uv in *channel)
-				concatenated.push_back(aiVector2t<float>(uv.x, uv.y));
-             }
+    mongo::BSONObjBuilder array(builder.subarrayStart(REPO_NODE_LABEL_BONES));
+    for (size_t b = 0; b < bones.size(); ++b)
+    {
+        mongo::BSONObjBuilder bone(
+                    array.subobjStart(RepoTranscoderBSON::getIndexKey(b)));
+        bone << REPO_NODE_LABEL_NAME << bones[b].name;
+
+        float values[16];
+        for (unsigned int i = 0; i < 16; ++i)
+            values[i] = bones[b].offsetMatrix[i / 4][i % 4];
+        bone.appendBinData(REPO_NODE_LABEL_BONE_OFFSET_MATRIX, sizeof(values),
+                           mongo::BinDataGeneral, values);
+        bone.done();
+    }
+    array.done();
+
+    //--------------------------------------------------------------------------
+    // Bone influences, reordered by whole vertices and split into byte planes
+    const size_t influenceSize = 2 * RepoTranscoderMesh::BONE_INFLUENCES_COUNT;
+    if (boneInfluences &&
+        boneInfluences->size() == verticesCount * influenceSize)
+    {
+        if (order)
+        {
+            std::vector<uint8_t> reordered(boneInfluences->size());
+            for (size_t i = 0; i < verticesCount; ++i)
+                std::copy(boneInfluences->begin() + i * influenceSize,
+                          boneInfluences->begin() + (i + 1) * influenceSize,
+                          reordered.begin() + (*order)[i] * influenceSize);
+            std::vector<uint8_t> planes = RepoTranscoderMesh::toBytePlanes(
+                        reordered.data(), verticesCount, influenceSize);
+            std::vector<uint8_t> packed = RepoTranscoderMesh::compress(
+                        planes.data(), planes.size());
+            RepoTranscoderBSON::append(
+                        REPO_NODE_LABEL_BONE_INFLUENCES, &packed, builder, "");
         }
+        else
+            RepoTranscoderBSON::append(
+                        REPO_NODE_LABEL_BONE_INFLUENCES,
+                        boneInfluences,
+                        builder,
+                        "");
+    }
+}
 
-		RepoTranscoderBSON::append(
-			REPO_NODE_LABEL_UV_CHANNELS,
-			&concatenated,
-			builder,
-			REPO_NODE_LABEL_UV_CHANNELS_BYTE_COUNT);
-	}
+void repo::core::RepoNodeMesh::retrieveTangentsAndBones(
+        const mongo::BSONObj &obj,
+        bool compressed)
+{
+    if (!obj.hasField(REPO_NODE_LABEL_VERTICES_COUNT))
+        return;
+    size_t verticesCount =
+            obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
 
+    //--------------------------------------------------------------------------
+    // Tangent frames
+    mongo::BSONElement bse = obj.getField(REPO_NODE_LABEL_TANGENT_FRAMES);
+    if (mongo::BinData == bse.type())
+    {
+        int len = 0;
+        const char *binData = bse.binData(len);
+        std::vector<int16_t> encoded;
+        if (compressed)
+            RepoTranscoderMesh::unpack(
+                        binData, std::max(len, 0), verticesCount * 3, encoded);
+        else if ((size_t) std::max(len, 0) ==
+                 verticesCount * 3 * sizeof(int16_t))
+        {
+            encoded.resize(verticesCount * 3);
+            memcpy(encoded.data(), binData, len);
+        }
 
-	return builder.obj();
+        // Normals are already retrieved, borrowed or decoded
+        RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+        if (verticesCount > 0 && encoded.size() == verticesCount * 3 &&
+            normalsData.size() == verticesCount)
+        {
+            tangents = new std::vector<aiVector3t<float> >();
+            bitangents = new std::vector<aiVector3t<float> >();
+            RepoTranscoderMesh::decodeTangents(
+                        encoded.data(),
+                        verticesCount,
+                        normalsData,
+                        *tangents,
+                        *bitangents);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Bones
+    bse = obj.getField(REPO_NODE_LABEL_BONES);
+    if (mongo::Array == bse.type())
+    {
+        mongo::BSONObjIterator it(bse.embeddedObject());
+        while (it.more())
+        {
+            mongo::BSONObj boneObj = it.next().embeddedObject();
+            Bone bone;
+            if (boneObj.hasField(REPO_NODE_LABEL_NAME))
+                bone.name = boneObj.getField(REPO_NODE_LABEL_NAME).str();
+
+            // Copied out value by value as the blob might not be aligned
+            mongo::BSONElement matrix =
+                    boneObj.getField(REPO_NODE_LABEL_BONE_OFFSET_MATRIX);
+            int len = 0;
+            const char *binData = mongo::BinData == matrix.type()
+                    ? matrix.binData(len) : NULL;
+            if (binData && sizeof(float) * 16 == (size_t) std::max(len, 0))
+            {
+                float values[16];
+                memcpy(values, binData, sizeof(values));
+                for (unsigned int i = 0; i < 16; ++i)
+                    bone.offsetMatrix[i / 4][i % 4] = values[i];
+            }
+            bones.push_back(bone);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Bone influences
+    const size_t influenceSize = 2 * RepoTranscoderMesh::BONE_INFLUENCES_COUNT;
+    bse = obj.getField(REPO_NODE_LABEL_BONE_INFLUENCES);
+    if (!bones.empty() && verticesCount > 0 && mongo::BinData == bse.type())
+    {
+        int len = 0;
+        const uint8_t *binData = (const uint8_t *) bse.binData(len);
+        std::vector<uint8_t> planes;
+        if (compressed &&
+            RepoTranscoderMesh::decompress(
+                binData,
+                std::max(len, 0),
+                verticesCount * influenceSize,
+                planes) &&
+            planes.size() == verticesCount * influenceSize)
+        {
+            boneInfluences = new std::vector<uint8_t>(planes.size());
+            RepoTranscoderMesh::fromBytePlanes(
+                        planes.data(),
+                        verticesCount,
+                        influenceSize,
+                        boneInfluences->data());
+        }
+        else if (!compressed &&
+                 (size_t) std::max(len, 0) == verticesCount * influenceSize)
+            boneInfluences = new std::vector<uint8_t>(binData, binData + len);
+    }
 }
 
+void repo::core::RepoNodeMesh::appendLegacyVertexChannels(
+        mongo::BSONObjBuilder &builder) const
+{
+    RepoBinaryView<aiVector2D> uvChannelsData = getUVChannelsView();
+    if (uvChannelsCount > 0 && !uvChannelsData.empty())
+    {
+        builder << REPO_NODE_LABEL_UV_CHANNELS_COUNT << uvChannelsCount;
+        RepoTranscoderBSON::append(
+                    REPO_NODE_LABEL_UV_CHANNELS,
+                    uvChannelsData,
+                    builder,
+                    REPO_NODE_LABEL_UV_CHANNELS_BYTE_COUNT);
+    }
+
+    RepoBinaryView<aiColor4D> colorsData = getColorSetView(0);
+    if (!colorsData.empty())
+        RepoTranscoderBSON::append(
+                    REPO_NODE_LABEL_COLORS,
+                    std::vector<aiColor4D>(colorsData.begin(), colorsData.end()),
+                    builder);
+}
+
+void repo::core::RepoNodeMesh::appendVertexChannels(
+        const RepoBinaryView<aiVector2D> &uvChannelsData,
+        const RepoBinaryView<aiColor4D> &colorsData,
+        size_t verticesCount,
+        mongo::BSONObjBuilder &builder) const
+{
+    //--------------------------------------------------------------------------
+    // Descriptors of complete channels only
+    std::vector<uint32_t> header(1, 0);
+    size_t floatsCount = 0;
+    for (unsigned int c = 0; c < uvChannelsCount &&
+         uvChannelsData.size() >= (c + 1) * verticesCount; ++c)
+    {
+        uint32_t components = c < uvComponents.size() ? uvComponents[c] : 2;
+        header.push_back(UV_CHANNEL | (c << 8) | (components << 16));
+        floatsCount += components * verticesCount;
+    }
+    for (unsigned int c = 0; c < colorSetsCount &&
+         colorsData.size() >= (c + 1) * verticesCount; ++c)
+    {
+        header.push_back(COLOR_SET | (c << 8) | (4 << 16));
+        floatsCount += 4 * verticesCount;
+    }
+    header[0] = (uint32_t) header.size() - 1;
+    if (0 == header[0] || 0 == verticesCount)
+        return;
+
+    //--------------------------------------------------------------------------
+    // Header followed by the channels in the order of their descriptors
+    std::vector<float> blob(header.size() + floatsCount);
+    memcpy(&blob[0], &header[0], header.size() * sizeof(uint32_t));
+    float *out = &blob[header.size()];
+    for (size_t d = 1; d < header.size(); ++d)
+    {
+        unsigned int channel = (header[d] >> 8) & 0xff;
+        if (UV_CHANNEL == (header[d] & 0xff))
+        {
+            bool uOnly = 1 == ((header[d] >> 16) & 0xff);
+            RepoBinaryView<aiVector2D> uvs = uvChannelsData.slice(
+                        channel * verticesCount, verticesCount);
+            for (size_t i = 0; i < uvs.size(); ++i)
+            {
+                aiVector2D uv = uvs[i];
+                *out++ = uv.x;
+                if (!uOnly)
+                    *out++ = uv.y;
+            }
+        }
+        else
+        {
+            colorsData.slice(channel * verticesCount, verticesCount).copyTo(
+                        reinterpret_cast<aiColor4D *>(out));
+            out += 4 * verticesCount;
+        }
+    }
+    RepoTranscoderBSON::append(REPO_NODE_LABEL_VERTEX_CHANNELS, &blob, builder);
+}
+
+void repo::core::RepoNodeMesh::retrieveVertexChannels(
+        const mongo::BSONObj &obj,
+        bool view)
+{
+    size_t verticesCount =
+            obj.getField(REPO_NODE_LABEL_VERTICES_COUNT).numberInt();
+    mongo::BSONElement bse = obj.getField(REPO_NODE_LABEL_VERTEX_CHANNELS);
+    if (bse.type() != mongo::BinData ||
+        bse.binDataType() != mongo::BinDataGeneral ||
+        0 == verticesCount)
+        return;
+
+    int length = 0;
+    const char *data = bse.binData(length);
+    size_t bytes = (size_t) std::max(length, 0);
+
+    //--------------------------------------------------------------------------
+    // Descriptors and offsets of channels in bytes, malformed blobs are ignored
+    uint32_t channelsCount = 0;
+    if (bytes >= sizeof(uint32_t))
+        memcpy(&channelsCount, data, sizeof(uint32_t));
+    if (channelsCount > (bytes - std::min(bytes, sizeof(uint32_t))) / sizeof(uint32_t))
+        return;
+
+    std::vector<uint32_t> descriptors(channelsCount);
+    std::vector<size_t> offsets(channelsCount);
+    if (channelsCount > 0)
+        memcpy(&descriptors[0], data + sizeof(uint32_t),
+               channelsCount * sizeof(uint32_t));
+    size_t offset = (channelsCount + 1) * sizeof(uint32_t);
+    unsigned int uvCount = 0;
+    unsigned int colorCount = 0;
+    bool contiguous2D = true;
+    for (uint32_t d = 0; d < channelsCount; ++d)
+    {
+        unsigned int components = (descriptors[d] >> 16) & 0xff;
+        offsets[d] = offset;
+        offset += components * verticesCount * sizeof(float);
+        if (UV_CHANNEL == (descriptors[d] & 0xff))
+        {
+            contiguous2D = contiguous2D && 2 == components &&
+                    d == uvCount && ((descriptors[d] >> 8) & 0xff) == d;
+            ++uvCount;
+        }
+        else if (COLOR_SET == (descriptors[d] & 0xff))
+            ++colorCount;
+    }
+    if (offset > bytes ||
+        uvCount > AI_MAX_NUMBER_OF_TEXTURECOORDS ||
+        colorCount > AI_MAX_NUMBER_OF_COLOR_SETS)
+        return;
+
+    //--------------------------------------------------------------------------
+    // UV channels are borrowed straight from the blob if they are stored
+    // exactly as held, copied otherwise
+    uvChannelsCount = uvCount;
+    uvComponents.assign(uvCount, 2);
+    if (view && contiguous2D && uvCount > 0)
+        uvChannelsView = RepoTranscoderBSON::retrieveView<uint32_t>(
+                    obj, REPO_NODE_LABEL_VERTEX_CHANNELS, bytes / sizeof(uint32_t)).
+                template reinterpret<aiVector2D>(
+                    offsets[0], uvCount * verticesCount);
+    if (uvCount > 0 && uvChannelsView.empty())
+        uvChannels = new std::vector<aiVector2t<float> >(uvCount * verticesCount);
+    if (colorCount > 0)
+        colors = new std::vector<aiColor4D>(
+                    colorCount * verticesCount, aiColor4D(0, 0, 0, 1));
+    colorSetsCount = colorCount;
+
+    for (uint32_t d = 0; d < channelsCount; ++d)
+    {
+        unsigned int channel = (descriptors[d] >> 8) & 0xff;
+        unsigned int components = (descriptors[d] >> 16) & 0xff;
+        const char *channelData = data + offsets[d];
+        if (UV_CHANNEL == (descriptors[d] & 0xff) && channel < uvCount)
+        {
+            uvComponents[channel] = 1 == components ? 1 : 2;
+            if (!uvChannels)
+                continue;
+            aiVector2t<float> *uvs = &(*uvChannels)[channel * verticesCount];
+            float uv[2] = { 0, 0 };
+            for (size_t i = 0; i < verticesCount; ++i)
+            {
+                memcpy(uv, channelData + i * components * sizeof(float),
+                       std::min(components, 2u) * sizeof(float));
+                uvs[i] = aiVector2t<float>(uv[0], uv[1]);
+            }
+        }
+        else if (COLOR_SET == (descriptors[d] & 0xff) && channel < colorCount)
+        {
+            aiColor4D *set = &(*colors)[channel * verticesCount];
+            for (size_t i = 0; i < verticesCount; ++i)
+                memcpy(&set[i], channelData + i * components * sizeof(float),
+                       std::min(components, 4u) * sizeof(float));
+        }
+    }
+
+    // In view mode, UV channels are always accessed through the view
+    if (view && uvChannels)
+        uvChannelsView = RepoBinaryView<aiVector2D>(uvChannels);
+}
 
 void repo::core::RepoNodeMesh::retrieveFacesArray(
     const mongo::BSONElement &bse,
 	const unsigned int api,
 	const unsigned int facesByteCount,
 	const unsigned int facesCount,
-    std::vector<aiFace> *faces)
+    RepoFaceBuffer *faces)
 {
-    //--------------------------------------------------------------------------
-	// TODO make use of RepoTranscoderBSON to retrieve vector of unsigned int
 	if (REPO_NODE_API_LEVEL_1 == api)
 	{
-		faces->resize(facesCount);
-		unsigned int * serializedFaces = new unsigned int[facesByteCount/sizeof(unsigned int)];
 		if (NULL != faces &&
-			NULL != serializedFaces &&
 			facesCount > 0 &&
+			bse.type() == mongo::BinData &&
 			bse.binDataType() == mongo::BinDataGeneral)
 		{
-			// Copy over all the integers
-			int len = (int) facesByteCount;
-			const char *binData = bse.binData(len);
-			memcpy(serializedFaces, binData, facesByteCount);
-
 			// Retrieve numbers of vertices for each face and subsequent
 			// indices into the vertex array.
 			// In API level 1, mesh is represented as
 			// [n1, v1, v2, ..., n2, v1, v2...]
-			unsigned int counter = 0;
-			int mNumIndicesIndex = 0;
-			while (counter < facesCount)
-			{
-				int mNumIndices = serializedFaces[mNumIndicesIndex];
-				aiFace face;
-				face.mNumIndices = mNumIndices;
-				unsigned int *indices = new unsigned int[mNumIndices];
-				for (int i = 0; i < mNumIndices; ++i)
-					indices[i] = serializedFaces[mNumIndicesIndex + 1 + i];
-				face.mIndices = indices;
-				(*faces)[counter] = face;
-				mNumIndicesIndex = mNumIndicesIndex + mNumIndices + 1;
-				++counter;
-			}
+			int len = 0;
+			const char *binData = bse.binData(len);
+			faces->appendSerialized(
+				binData,
+				std::min((size_t) facesByteCount, (size_t) std::max(len, 0)),
+				facesCount);
 		}
-
-		// Memory cleanup
-		if (NULL != serializedFaces)
-			delete [] serializedFaces;
-
 	}
 	else if (REPO_NODE_API_LEVEL_2 == api)
 	{
-		// TODO: triangles only
+		// In API level 2, mesh is represented as [v1, v2, v3, v1, v2, v3...]
+		// with the index size given by the byte count.
+		if (NULL != faces &&
+			facesCount > 0 &&
+			bse.type() == mongo::BinData &&
+			bse.binDataType() == mongo::BinDataGeneral)
+		{
+			int len = 0;
+			const char *binData = bse.binData(len);
+			unsigned int indexSize = facesByteCount / (3 * facesCount);
+			if ((size_t) std::max(len, 0) >= (size_t) facesCount * 3 * indexSize &&
+				facesByteCount == facesCount * 3 * indexSize)
+				faces->assignTriangles(binData, facesCount, indexSize);
+		}
 	}
 	else if (REPO_NODE_API_LEVEL_3 == api)
 	{
-		// TODO: compression
+		// In API level 3, triangle indices are stored as compressed zigzag
+		// deltas, see RepoTranscoderMesh.
+		if (NULL != faces &&
+			facesCount > 0 &&
+			bse.type() == mongo::BinData &&
+			bse.binDataType() == mongo::BinDataGeneral)
+		{
+			int len = 0;
+			const char *binData = bse.binData(len);
+			std::vector<uint32_t> encoded;
+			if (RepoTranscoderMesh::unpack(
+					binData,
+					std::min((size_t) facesByteCount, (size_t) std::max(len, 0)),
+					(size_t) facesCount * 3,
+					encoded) &&
+				encoded.size() == (size_t) facesCount * 3)
+			{
+				std::vector<uint32_t> indices;
+				RepoTranscoderMesh::decodeIndices(
+					encoded.data(), encoded.size(), indices);
+				faces->assignTriangles(
+					(const char *) indices.data(), facesCount, sizeof(uint32_t));
+			}
+		}
 	}
 }
 
@@ -538,6 +1383,8 @@ void repo::core::RepoNodeMesh::toAssimp(
 		const std::map<const RepoNodeAbstract *, unsigned int> materialMapping,
 		aiMesh * mesh) const
 {
+    ensureGeometry();
+
     //--------------------------------------------------------------------------
 	// Name
 	mesh->mName = aiString(name);
@@ -546,13 +1393,12 @@ void repo::core::RepoNodeMesh::toAssimp(
 	// Faces
 	if (NULL != faces && 0 < faces->size())
 	{
-		aiFace * facesArray = new aiFace[faces->size()];
+		aiFace * facesArray = faces->toAssimp();
 		if (NULL != facesArray)
 		{
-			std::copy(faces->begin(), faces->end(), facesArray);
 			mesh->mFaces = facesArray;
             mesh->mNumFaces = (unsigned int) faces->size();
-			mesh->mPrimitiveTypes = 4; // TODO: work out the exact primitive type of each mesh!
+			mesh->mPrimitiveTypes = faces->getPrimitiveTypes();
 		}
 		else
 			mesh->mNumFaces = 0;
@@ -563,12 +1409,13 @@ void repo::core::RepoNodeMesh::toAssimp(
     //--------------------------------------------------------------------------
 	// Vertices
 	// Make a copy of vertices
-	aiVector3D * verticesArray = new aiVector3D[vertices->size()];
+    RepoBinaryView<aiVector3D> verticesData = getVerticesView();
+	aiVector3D * verticesArray = new aiVector3D[verticesData.size()];
 	if (NULL != verticesArray)
 	{
-		std::copy(vertices->begin(), vertices->end(), verticesArray);
+		std::copy(verticesData.begin(), verticesData.end(), verticesArray);
 		mesh->mVertices = verticesArray;
-        mesh->mNumVertices = (unsigned int) vertices->size();
+        mesh->mNumVertices = (unsigned int) verticesData.size();
 	}
 	else
 		mesh->mNumVertices = 0;
@@ -576,40 +1423,85 @@ void repo::core::RepoNodeMesh::toAssimp(
     //--------------------------------------------------------------------------
 	// Normals
 	// Make a copy of normals
-	if (NULL != normals && 0 < normals->size())
+    RepoBinaryView<aiVector3D> normalsData = getNormalsView();
+	if (0 < normalsData.size())
 	{
-		aiVector3D * normalsArray = new aiVector3D[normals->size()];
+		aiVector3D * normalsArray = new aiVector3D[normalsData.size()];
 		if (NULL != normalsArray)
 		{
-			std::copy(normals->begin(), normals->end(), normalsArray);
+			std::copy(normalsData.begin(), normalsData.end(), normalsArray);
 			mesh->mNormals = normalsArray;
 		}
 	}
 
     //--------------------------------------------------------------------------
 	// Texture coordinates
-	//
-	// TODO: change to support U and UVW, not just UV as done now.
-	if (NULL != uvChannels && 0 < uvChannels->size())
+	for (unsigned int i = 0; i < uvChannelsCount &&
+		i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
 	{
-		for (unsigned int i = 0; i < uvChannels->size() &&
-			i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
+		RepoBinaryView<aiVector2D> channel = getUVChannelView(i);
+		aiVector3D * texCoords = new aiVector3D[verticesData.size()];
+		for (size_t j = 0; j < channel.size() && j < verticesData.size(); ++j)
+			texCoords[j] = aiVector3D(channel[j].x, channel[j].y, 0);
+		mesh->mTextureCoords[i] = texCoords;
+		mesh->mNumUVComponents[i] = getUVComponentsCount(i); // U or UV
+	}
+
+    //--------------------------------------------------------------------------
+	// Tangents and bitangents
+	if (NULL != tangents && NULL != bitangents &&
+		tangents->size() == verticesData.size() &&
+		bitangents->size() == verticesData.size() &&
+		!tangents->empty())
+	{
+		mesh->mTangents = new aiVector3D[tangents->size()];
+		std::copy(tangents->begin(), tangents->end(), mesh->mTangents);
+		mesh->mBitangents = new aiVector3D[bitangents->size()];
+		std::copy(bitangents->begin(), bitangents->end(), mesh->mBitangents);
+	}
+
+    //--------------------------------------------------------------------------
+	// Bones, weights are unpacked from the bone influences
+	if (!bones.empty())
+	{
+		std::vector<std::vector<aiVertexWeight> > weights;
+		if (NULL != boneInfluences && boneInfluences->size() ==
+			verticesData.size() * 2 * RepoTranscoderMesh::BONE_INFLUENCES_COUNT)
+			RepoTranscoderMesh::decodeBoneWeights(
+				boneInfluences->data(),
+				verticesData.size(),
+				(unsigned int) bones.size(),
+				weights);
+		weights.resize(bones.size());
+
+		mesh->mNumBones = (unsigned int) bones.size();
+		mesh->mBones = new aiBone*[bones.size()];
+		for (size_t b = 0; b < bones.size(); ++b)
 		{
-			aiVector3D * texCoords = new aiVector3D[vertices->size()];
-			std::copy(uvChannels->at(i)->begin(), uvChannels->at(i)->end(),
-				texCoords);
-			mesh->mTextureCoords[i] = texCoords;
-			mesh->mNumUVComponents[i] = 2; // UV
+			aiBone *bone = new aiBone();
+			bone->mName = aiString(bones[b].name);
+			bone->mOffsetMatrix = bones[b].offsetMatrix;
+			bone->mNumWeights = (unsigned int) weights[b].size();
+			if (!weights[b].empty())
+			{
+				bone->mWeights = new aiVertexWeight[weights[b].size()];
+				std::copy(weights[b].begin(), weights[b].end(), bone->mWeights);
+			}
+			mesh->mBones[b] = bone;
 		}
 	}
 
     //--------------------------------------------------------------------------
     // Vertex colors
-    if(NULL != colors && 0 < colors->size())
+	for (unsigned int i = 0; i < colorSetsCount &&
+		i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
     {
-        aiColor4D * colorsArray = new aiColor4D[colors->size()];
-        std::copy(colors->begin(), colors->end(), colorsArray);
-        mesh->mColors[0] = colorsArray;
+		RepoBinaryView<aiColor4D> set = getColorSetView(i);
+        aiColor4D * colorsArray = new aiColor4D[verticesData.size()];
+        std::copy(set.begin(),
+                  set.begin() + std::min(set.size(), verticesData.size()),
+                  colorsArray);
+        mesh->mColors[i] = colorsArray;
     }
 
     //--------------------------------------------------------------------------
@@ -631,11 +1523,21 @@ void repo::core::RepoNodeMesh::toAssimp(
 	}
 }
 
+void repo::core::RepoNodeMesh::moveToAssimp(
+		const std::map<const RepoNodeAbstract *, unsigned int> &materialMapping,
+		aiMesh * mesh)
+{
+	toAssimp(materialMapping, mesh);
+	clearGeometry();
+	geometryLoaded = false;
+}
+
 //------------------------------------------------------------------------------
 double repo::core::RepoNodeMesh::getFaceArea(const unsigned int& index) const
 {
 	double area = 0;
-	const aiFace& face = faces->at(index);
+    ensureVectors();
+	const RepoFace face = faces->at(index);
 	if (3 == face.mNumIndices || 4 == face.mNumIndices)
 	{
 		area = getTriangleArea(face, 0, 1, 2);
@@ -650,7 +1552,8 @@ double repo::core::RepoNodeMesh::getFacePerimeter(const unsigned int& index)
 	const
 {
 	double perimeter = 0;
-	const aiFace& face = faces->at(index);
+    ensureVectors();
+	const RepoFace face = faces->at(index);
 	aiVector3t<float> v;
 	for (unsigned int i = 0; i < face.mNumIndices; ++i)
 	{
@@ -670,8 +1573,9 @@ double repo::core::RepoNodeMesh::getFacesBoundaryLength(
 	const unsigned int & faceIndexB) const
 {
 	double boundaryLength = 0;
-	const aiFace & faceA = faces->at(faceIndexA);
-	const aiFace & faceB = faces->at(faceIndexB);
+    ensureVectors();
+	const RepoFace faceA = faces->at(faceIndexA);
+	const RepoFace faceB = faces->at(faceIndexB);
 
 	std::vector<repo::core::RepoVertex> commonVertices;
 	for (unsigned int i = 0; i < faceA.mNumIndices; ++i)
@@ -697,7 +1601,7 @@ double repo::core::RepoNodeMesh::getFacesBoundaryLength(
 
 //------------------------------------------------------------------------------
 double repo::core::RepoNodeMesh::getTriangleArea(
-	const aiFace& face,
+	const RepoFace& face,
 	const unsigned int& indexA,
 	const unsigned int& indexB,
 	const unsigned int& indexC) const
@@ -727,23 +1631,18 @@ repo::core::RepoVertex
 	repo::core::RepoNodeMesh::getFaceCentroid(unsigned int index) const
 {
 	RepoVertex centroid;
-	const aiFace& face = faces->at(index);
+    ensureVectors();
+	const RepoFace face = faces->at(index);
 	for (unsigned int i = 0; i < face.mNumIndices; ++i)
 		centroid += vertices->at(face.mIndices[i]);
 	centroid /= face.mNumIndices;
 	return centroid;
 }
 
-std::string repo::core::RepoNodeMesh::getVertexHash()
-{
-    if (vertexHash.empty())
-        setVertexHash();
-    return vertexHash;
-}
-
 void repo::core::RepoNodeMesh::setVertexHash()
 {
-    pca.initialize(*vertices);
+    pca.initialize(getVertexAttributes(
+        RepoVertexAttributes::getMask(RepoVertexAttributes::POSITION)));
 
     setVertexHash(hash(pca.getUnweightedUVWVertices(), pca.getUVWBoundingBox()));
 
@@ -771,27 +1670,56 @@ inline float fround(double n, unsigned d)
   return (float)(floor(n * pow(10.0, p) + 0.5) / pow(10.0, p));
 }
 
+namespace {
+
+//! Sorts keys by LSD radix sort in 11-bit digits using a single scratch buffer.
+/*!
+ * Digits shared by all keys, typically the high ones, are skipped.
+ */
+void radixSort(std::vector<repo::core::hash_type> &keys)
+{
+    const unsigned int digitBits = 11;
+    const size_t bucketsCount = size_t(1) << digitBits;
+    const repo::core::hash_type mask = bucketsCount - 1;
+    size_t count = keys.size();
+    if (count < 2)
+        return;
+
+    std::vector<repo::core::hash_type> scratch(count);
+    repo::core::hash_type *source = keys.data();
+    repo::core::hash_type *destination = scratch.data();
+    size_t offsets[bucketsCount];
+    for (unsigned int shift = 0; shift < 64; shift += digitBits)
+    {
+        std::fill(offsets, offsets + bucketsCount, 0);
+        for (size_t i = 0; i < count; ++i)
+            ++offsets[(source[i] >> shift) & mask];
+        if (count == offsets[(source[0] >> shift) & mask])
+            continue;
+
+        size_t offset = 0;
+        for (size_t b = 0; b < bucketsCount; ++b)
+        {
+            size_t bucketSize = offsets[b];
+            offsets[b] = offset;
+            offset += bucketSize;
+        }
+        for (size_t i = 0; i < count; ++i)
+            destination[offsets[(source[i] >> shift) & mask]++] = source[i];
+        std::swap(source, destination);
+    }
+    if (source != keys.data())
+        keys.swap(scratch);
+}
+
+} // end namespace
+
 //------------------------------------------------------------------------------
 std::string repo::core::RepoNodeMesh::hash(
-        const std::vector<aiVector3t<float> >& originalVertices,
+        const std::vector<aiVector3t<float> >& vertices,
         const RepoBoundingBox& boundingBox,
         double hashDensity)
 {
-//    std::cerr << std::endl;
-//    std::cerr << "Mesh" << std::endl;
-	std::vector<hash_type> vertexHashes;
-
-
-    std::set<aiVector3t<float> > verticesSet(originalVertices.begin(), originalVertices.end());
-    std::vector<aiVector3t<float> > vertices(verticesSet.begin(), verticesSet.end());
-
-
-//    std::sort(vertices.begin(), vertices.end(), RepoaiVertexComparator());
-//    auto uniqueEnd = std::unique(vertices.begin(), vertices.end(), RepoaiVertexComparator());
-//    vertices.erase(uniqueEnd, vertices.end());
-
-    vertexHashes.resize(vertices.size());
-
 	const aiVector3t<float> &min = boundingBox.getMin();
 	const aiVector3t<float> &max = boundingBox.getMax();
 
@@ -799,11 +1727,14 @@ std::string repo::core::RepoNodeMesh::hash(
 	float stride_y = (max.y - min.y);
 	float stride_z = (max.z - min.z);
 
-    for(int v_idx = 0; v_idx < vertices.size(); v_idx++)
+    //--------------------------------------------------------------------------
+    // Vertices are quantized first so that duplicates become equal keys
+    std::vector<hash_type> vertexHashes(vertices.size());
+    for (size_t v_idx = 0; v_idx < vertices.size(); v_idx++)
 	{
-        double norm_x = (vertices.at(v_idx).x - min.x) / stride_x;
-        double norm_y = (vertices.at(v_idx).y - min.y) / stride_y;
-        double norm_z = (vertices.at(v_idx).z - min.z) / stride_z;
+        double norm_x = (vertices[v_idx].x - min.x) / stride_x;
+        double norm_y = (vertices[v_idx].y - min.y) / stride_y;
+        double norm_z = (vertices[v_idx].z - min.z) / stride_z;
 
 		hash_type x_coord = (hash_type)round(hashDensity * norm_x);
 		hash_type y_coord = (hash_type)round(hashDensity * norm_y);
@@ -814,43 +1745,26 @@ std::string repo::core::RepoNodeMesh::hash(
 			+ (hash_type)round(hashDensity * hashDensity * z_coord);
 
 		vertexHashes[v_idx] = vertexIndex;
-
-//        if (vertices.size() < 100)
-//            std::cerr << "[ " << norm_x << ", " << norm_y << ", " << norm_z << " ]";
 	}
 
-//    std::cerr << std::endl;
-
-    std::sort(vertexHashes.begin(), vertexHashes.end());
-//    std::unique(vertexHashes.begin(), vertexHashes.end());
-
-//    for(auto v : vertexHashes)
-//    {
-//        std::cerr << v << " ";
-//    }
-//    std::cerr << std::endl;
-
-    size_t bufSize = vertexHashes.size() * sizeof(hash_type) + sizeof(float) * 3;
-    char *buf = new char[bufSize];
-
-    memcpy(buf, (char *)(&vertexHashes[0]), vertexHashes.size() * sizeof(hash_type));
-    unsigned int idx = vertexHashes.size() * sizeof(hash_type);
+    //--------------------------------------------------------------------------
+    // Sorted and deduplicated in place
+    radixSort(vertexHashes);
+    vertexHashes.erase(
+                std::unique(vertexHashes.begin(), vertexHashes.end()),
+                vertexHashes.end());
 
-	/*
-	stride_x = (float)(floor((double)stride_x * 10000.0) / 10000.0);
-	stride_y = (float)(floor((double)stride_y * 10000.0) / 10000.0);
-	stride_z = (float)(floor((double)stride_z * 10000.0) / 10000.0);
-	*/
+    //--------------------------------------------------------------------------
+    // Sorted hashes followed by the rounded strides, streamed without a copy
+    RepoSHA256 sha;
+    sha.update(vertexHashes.data(), vertexHashes.size() * sizeof(hash_type));
 
 	stride_x = fround(stride_x, 3);
 	stride_y = fround(stride_y, 3);
 	stride_z = fround(stride_z, 3);
 
-    *((float *)(buf + idx)) = stride_x;
-    *((float *)(buf + idx + sizeof(float))) = stride_y;
-    *((float *)(buf + idx + 2 * sizeof(float))) = stride_z;
-
-//    std::cerr << stride_x << " " << stride_y << " " << stride_z << " " << sha256(std::string(buf, bufSize)) << std::endl;
+    const float strides[3] = { stride_x, stride_y, stride_z };
+    sha.update(strides, sizeof(strides));
 
-    return sha256(std::string(buf, bufSize));
+    return sha.finalHex();
 }
@@ -19,17 +19,24 @@
 #define REPO_NODE_MESH_H
 
 #include <vector>
+#include <list>
+#include <atomic>
+#include <mutex>
+#include <memory>
 //------------------------------------------------------------------------------
 #include "repo_node_abstract.h"
 #include "repo_bounding_box.h"
+#include "repo_geometry_loader.h"
 #include "../primitives/repo_vertex.h"
+#include "../primitives/repobinaryview.h"
+#include "../primitives/repofacebuffer.h"
+#include "../primitives/repovertexattributes.h"
 #include "../compute/repo_pca.h"
 //------------------------------------------------------------------------------
 #include "assimp/scene.h"
 
 //------------------------------------------------------------------------------
 #include <stdint.h>
-#include "../sha256/sha256.h"
 
 //------------------------------------------------------------------------------
 #include "../repocoreglobal.h"
@@ -61,7 +68,13 @@ namespace core {
 #define REPO_NODE_LABEL_UV_CHANNELS_COUNT		"uv_channels_count"
 #define REPO_NODE_LABEL_UV_CHANNELS_BYTE_COUNT	"uv_channels_byte_count"
 #define REPO_NODE_LABEL_SHA256                  "sha256"
+#define REPO_NODE_LABEL_SHA256_SCHEME           "sha256_scheme" //!< see REPO_VERTEX_HASH_SCHEME
 #define REPO_NODE_LABEL_COLORS                  "colors"
+#define REPO_NODE_LABEL_VERTEX_CHANNELS         "vertex_channels" //!< packed uvs and colors
+#define REPO_NODE_LABEL_TANGENT_FRAMES          "tangent_frames" //!< encoded tangents
+#define REPO_NODE_LABEL_BONES                   "bones" //!< array of bones
+#define REPO_NODE_LABEL_BONE_OFFSET_MATRIX      "offset_matrix"
+#define REPO_NODE_LABEL_BONE_INFLUENCES         "bone_influences" //!< packed weights
 //------------------------------------------------------------------------------
 #define REPO_NODE_UUID_SUFFIX_MESH				"08" //!< uuid suffix
 //------------------------------------------------------------------------------
@@ -69,16 +82,65 @@ namespace core {
 typedef uint64_t hash_type;
 #define REPO_HASH_DENSITY 2097152 // 2^21
 
+//! Version of RepoNodeMesh::hash(), to be increased whenever its output changes.
+#define REPO_VERTEX_HASH_SCHEME 2
+
 
 //! Mesh scene graph node, corresponds to aiMesh in Assimp.
 /*!
  * In API level 1, faces are stored as [n1, v1, v2, ..., n2, v1, v2...] where
  * 'n' is the number of consecutive vertex indices 'v' that contribute to a
  * single face.
+ *
+ * In API level 2, meshes consist of triangles only and faces are stored as
+ * [v1, v2, v3, v1, v2, v3...] using 16-bit indices whenever all of them fit,
+ * 32-bit otherwise. The index size follows from the faces byte count.
+ *
+ * In API level 3, triangle meshes are compressed, see RepoTranscoderMesh.
+ * Triangles are reordered for the vertex cache and vertices by their first
+ * use. Vertices are then quantized to 16 bits within the bounding box,
+ * normals are octahedron encoded and indices are stored as zigzag deltas,
+ * each compressed separately. UV channels and colors are reordered along
+ * and stored uncompressed. Compressed meshes cannot be retrieved in view
+ * mode.
+ *
+ * Uncompressed meshes store all UV channels in 2D as uv_channels and the
+ * first color set as colors, as API level 1 clients expect. Meshes with U
+ * only channels or more than one color set additionally store all of them
+ * in a vertex_channels blob, as do compressed meshes instead. It starts with
+ * the number of channels followed by a 32-bit descriptor per channel, see
+ * VertexChannel, and then the float data of each channel in turn, vertex by
+ * vertex. The blob takes precedence over the separate fields when reading.
+ *
+ * Tangents of meshes with normals are octahedron encoded into a single
+ * tangent_frames blob, all u and v values of the tangents followed by the
+ * handedness of each frame, see RepoTranscoderMesh::encodeTangents(), from
+ * which the bitangents are reconstructed. Skinned meshes store an array of
+ * bones with their names and offset matrices as 16 floats, and
+ * bone_influences of 8 bytes per vertex, see
+ * RepoTranscoderMesh::encodeBoneWeights(). In API level 3 both blobs are
+ * reordered as the vertices and compressed.
  */
 class REPO_CORE_EXPORT RepoNodeMesh : public RepoNodeAbstract
 {
 
+public :
+
+    /*!
+     * Kinds of channels in the vertex_channels blob. A descriptor holds the
+     * kind in its lowest byte, the index of the UV channel or color set in
+     * the next one and the number of float components in the third one.
+     */
+    enum VertexChannel { UV_CHANNEL = 0, COLOR_SET = 1 };
+
+    //! Bone of a skinned mesh, corresponds to aiBone without its weights.
+    struct Bone
+    {
+        std::string name;
+
+        aiMatrix4x4 offsetMatrix; //!< From mesh space to bone space.
+    };
+
 public :
 
     //--------------------------------------------------------------------------
@@ -99,7 +161,17 @@ public :
 			normals(NULL),
             outline(NULL),
             uvChannels(NULL),
-            colors(NULL){}
+            colors(NULL),
+            tangents(NULL),
+            bitangents(NULL),
+            boneInfluences(NULL),
+            uvChannelsCount(0),
+            colorSetsCount(0),
+            viewMode(false),
+            vectorsMaterialized(true),
+            geometryLoaded(true),
+            geometryLoader(NULL),
+            storedVerticesCount(0) {}
 
 	//! Constructs mesh scene graph node from Assimp's aiMesh.
 	/*!
@@ -107,7 +179,8 @@ public :
 	 * created. The constructor attaches child materials if any.
 	 *
 	 * \param api Api level of this mesh, used to decide how to store it in
-	 * the repository.
+	 * the repository. API levels 2 and 3 fall back to level 1 unless all
+	 * faces of the mesh are triangles.
 	 * \param mesh Assimp mesh
 	 * \param materials Vector of materials out of which some become children
 	 * of this mesh
@@ -119,16 +192,35 @@ public :
         const aiMesh *mesh,
         const std::vector<RepoNodeAbstract *> &materials);
 
+	/*!
+	 * Same as above, but takes ownership of the aiMesh. Vertices and normals
+	 * are adopted without copying and held in views, as in view mode, the
+	 * remainder of the aiMesh is deleted before the constructor returns.
+	 * Assimp arrays have to be allocated by the same runtime as this library.
+	 */
+	RepoNodeMesh(
+		const unsigned int api,
+        std::unique_ptr<aiMesh> mesh,
+        const std::vector<RepoNodeAbstract *> &materials);
+
 	//! Constructs mesh scene graph component from a BSON object.
 	/*!
 	 * Same as all other components, it has to have a uuid, type, api
 	 * and optional name. In addition, stored vertices, faces and normals are
-	 * retrieved.
+	 * retrieved. If the object has been retrieved without its geometry
+	 * fields (see getGeometryFields()), the mesh is created without geometry
+	 * which can be populated later via setGeometry() or a geometry loader.
+	 *
+	 * In view mode, vertices, normals and UV channels are not copied out of
+	 * the object, the mesh borrows them from its buffer instead, see
+	 * getVerticesView(). Vectors returned by getVertices() and getNormals()
+	 * are then created only on their first use.
 	 *
 	 * \param obj BSON representation
+	 * \param view True to borrow binary geometry from the BSON buffer
 	 * \sa RepoNodeMesh()
 	 */
-	RepoNodeMesh(const mongo::BSONObj & obj);
+	RepoNodeMesh(const mongo::BSONObj & obj, bool view = false);
 
     //--------------------------------------------------------------------------
     //
@@ -174,49 +266,133 @@ public :
 		const std::map<const RepoNodeAbstract *, unsigned int> materialMapping,
 		aiMesh * mesh) const;
 
+	/*!
+	 * Same as toAssimp(), but releases the geometry of this mesh straight
+	 * after it has been copied into the aiMesh, which owns its arrays as
+	 * usual in Assimp. Ownership is not transferred, the geometry is held
+	 * twice for the duration of the call. The mesh is left without geometry
+	 * afterwards and isGeometryLoaded() returns false.
+	 */
+	void moveToAssimp(
+		const std::map<const RepoNodeAbstract *, unsigned int> &materialMapping,
+		aiMesh * mesh);
+
     //--------------------------------------------------------------------------
 	//
 	// Getters
 	//
     //--------------------------------------------------------------------------
 
-	//! Return the faces vector.
-	const std::vector<aiFace> * getFaces() const
-	{ return faces; }
+	//! Returns the faces stored in a single contiguous index buffer.
+	const RepoFaceBuffer * getFaces() const
+	{ ensureGeometry(); return faces; }
 
 	//! Return the normals vector.
     const std::vector<aiVector3D> * getNormals() const
-	{ return normals; }
+	{ ensureVectors(); return normals; }
 
 	//! Returns the vertices vector.
     const std::vector<aiVector3D> * getVertices() const
-	{ return vertices; }
-
-	//! Returns the texcoord vector.
-    const std::vector<aiVector3D> * getUVChannel(int channel = 0) const
-	{
-        std::vector<aiVector3D> *tmp = NULL;
-        if (uvChannels && (uvChannels->size() > 0))
-            tmp = (*uvChannels)[channel];
-        return tmp;
+	{ ensureVectors(); return vertices; }
+
+    /*!
+     * Returns a read-only view of vertices which does not copy them. In view
+     * mode they are borrowed from the BSON buffer, regardless of alignment,
+     * see RepoBinaryView.
+     */
+    RepoBinaryView<aiVector3D> getVerticesView() const
+    {
+        ensureGeometry();
+        return viewMode ? verticesView : RepoBinaryView<aiVector3D>(vertices);
+    }
+
+    //! Returns a read-only view of normals, same as getVerticesView().
+    RepoBinaryView<aiVector3D> getNormalsView() const
+    {
+        ensureGeometry();
+        return viewMode ? normalsView : RepoBinaryView<aiVector3D>(normals);
+    }
+
+    /*!
+     * Returns a read-only view of 2D UV coordinates of given channel, empty
+     * if not available.
+     */
+    RepoBinaryView<aiVector2D> getUVChannelView(unsigned int channel = 0) const;
+
+    //! Returns the number of UV channels.
+    unsigned int getUVChannelsCount() const
+    { ensureGeometry(); return uvChannelsCount; }
+
+    /*!
+     * Returns the number of meaningful components of a UV channel, 1 for U
+     * and 2 for UV. Channels are always held in 2D, W of 3D texture
+     * coordinates is not kept.
+     */
+    unsigned int getUVComponentsCount(unsigned int channel) const
+    {
+        ensureGeometry();
+        return channel < uvComponents.size() ? uvComponents[channel] : 2;
     }
 
+    //! Returns the tangents, only present along with the bitangents.
+    const std::vector<aiVector3D> * getTangents() const
+    { ensureGeometry(); return tangents; }
+
+    //! Returns the bitangents, only present along with the tangents.
+    const std::vector<aiVector3D> * getBitangents() const
+    { ensureGeometry(); return bitangents; }
+
+    //! Returns the bones of a skinned mesh.
+    const std::vector<Bone> &getBones() const
+    { ensureGeometry(); return bones; }
+
+    /*!
+     * Returns the bone influences, 8 bytes per vertex as packed by
+     * RepoTranscoderMesh::encodeBoneWeights(), NULL if there are no bones.
+     */
+    const std::vector<uint8_t> * getBoneInfluences() const
+    { ensureGeometry(); return boneInfluences; }
+
+    //! Returns the number of vertex color sets.
+    unsigned int getColorSetsCount() const
+    { ensureGeometry(); return colorSetsCount; }
+
+    //! Returns a view of colors of given set, empty if not available.
+    RepoBinaryView<aiColor4D> getColorSetView(unsigned int set = 0) const;
+
+    /*!
+     * Returns a copy of the requested attributes in an aligned buffer of given
+     * layout for vectorized processing. Attributes are a bit mask of
+     * RepoVertexAttributes::getMask() values, those the mesh does not have
+     * are left out.
+     */
+    RepoVertexAttributes getVertexAttributes(
+            unsigned int attributes,
+            RepoVertexAttributes::Layout layout =
+                RepoVertexAttributes::STRUCTURE_OF_ARRAYS) const;
+
+    //! Returns true if the geometry is borrowed from a BSON buffer.
+    bool isViewMode() const { return viewMode; }
+
     //! Returns outline of this mesh.
     const std::vector<aiVector2D> *getOutline() const
     { return outline; }
 
-	std::string getVertexHash() const;
+    /*!
+     * Returns the SHA-256 hash of the PCA aligned vertices if it has been
+     * calculated by setVertexHash() or stored in the document, empty
+     * otherwise.
+     */
+    std::string getVertexHash() const { return vertexHash; }
 
-    //! Returns the vertices colors.
+    //! Returns the vertices colors, all color sets concatenated.
     const std::vector<aiColor4D > *getColors() const
-    { return colors; }
+    { ensureGeometry(); return colors; }
 
     //! Returns bounding box of the mesh.
     const RepoBoundingBox &getBoundingBox() const
     { return boundingBox; }
 
-    std::string getVertexHash();
-
 	//! Returns the area of a face identified by its index.
 	double getFaceArea(const unsigned int & index) const;
 
@@ -234,7 +410,7 @@ public :
 	 * returns zero.
 	 */
 	double getTriangleArea(
-		const aiFace & face,
+		const RepoFace & face,
 		const unsigned int & indexA,
 		const unsigned int & indexB,
 		const unsigned int & indexC) const;
@@ -247,9 +423,56 @@ public :
     void setVertexHash(const std::string& hash)
     { this->vertexHash = hash; }
 
-    //! Calculates the vertex hash by first PCA-aligning the vertices.
+    //! Returns true if the vertex hash has already been calculated.
+    bool hasVertexHash() const { return !vertexHash.empty(); }
+
+    /*!
+     * Calculates the vertex hash by first PCA-aligning the vertices. Scenes
+     * call it for all their meshes when serialized for a commit, see
+     * RepoGraphScene::toBSONObjs().
+     */
     void setVertexHash();
 
+    //--------------------------------------------------------------------------
+	//
+	// Geometry
+	//
+    //--------------------------------------------------------------------------
+
+    //! Returns true if vertices, faces, normals, uvs and colors are populated.
+    bool isGeometryLoaded() const { return geometryLoaded; }
+
+    /*!
+     * Returns the number of vertices without loading the geometry. Until it
+     * is loaded, this is the count recorded in the document.
+     */
+    size_t getVerticesCount() const
+    {
+        return geometryLoaded
+                ? getVerticesView().size()
+                : (size_t) storedVerticesCount;
+    }
+
+    /*!
+     * Sets the loader asked to populate the geometry on first access. Does not
+     * take ownership of the loader.
+     */
+    void setGeometryLoader(RepoGeometryLoader *loader)
+    { geometryLoader = loader; }
+
+    /*!
+     * Populates vertices, faces, normals, uvs and colors from a BSON object,
+     * any previous geometry is discarded. In view mode, binary geometry is
+     * borrowed from the object's buffer rather than copied.
+     */
+    void setGeometry(const mongo::BSONObj &obj, bool view = false);
+
+    /*!
+     * Returns labels of the binary geometry fields, ie those which can be
+     * excluded when retrieving a scene skeleton.
+     */
+    static std::list<std::string> getGeometryFields();
+
     //--------------------------------------------------------------------------
 	//
 	// Faces
@@ -257,21 +480,105 @@ public :
     //--------------------------------------------------------------------------
 
 	/*!
-	 * Retrieves faces vector from binary BSON element depending on the API
-	 * level.
+	 * Retrieves faces from binary BSON element depending on the API level.
+	 * Indices are copied straight into the contiguous buffer.
 	 */
 	static void retrieveFacesArray(
 		const mongo::BSONElement &,
 		const unsigned int api,
 		const unsigned int facesByteCount,
 		const unsigned int facesCount,
-		std::vector<aiFace> * faces);
+		RepoFaceBuffer * faces);
 
 
     //! Returns hash of a given array of [x,y,z] coordinates.
     static std::string hash(const std::vector<aiVector3t<float> > &,
             const RepoBoundingBox&, double hashDensity = 500);
 
+protected :
+
+    /*!
+     * Converts faces, UV channels, colors and the bounding box of the aiMesh
+     * and attaches child materials. Vertices and normals are left to the
+     * constructors.
+     */
+    void initialize(
+            const aiMesh *mesh,
+            const std::vector<RepoNodeAbstract *> &materials);
+
+    //! Deallocates vertices, faces, normals, uvs, colors, tangents and bones.
+    void clearGeometry();
+
+    //! Asks the geometry loader to populate geometry if not loaded yet.
+    void ensureGeometry() const
+    {
+        RepoGeometryLoader *loader = geometryLoader;
+        if (!geometryLoaded && loader)
+            loader->load(const_cast<RepoNodeMesh *>(this));
+    }
+
+    //! Populates vectors from views in view mode if not done yet.
+    void ensureVectors() const
+    {
+        ensureGeometry();
+        if (!vectorsMaterialized)
+            const_cast<RepoNodeMesh *>(this)->materializeVectors();
+    }
+
+    //! Copies vertices and normals out of their views.
+    void materializeVectors();
+
+    //! Returns all UV channels concatenated, borrowed or owned.
+    RepoBinaryView<aiVector2D> getUVChannelsView() const
+    {
+        return viewMode
+                ? uvChannelsView
+                : RepoBinaryView<aiVector2D>(uvChannels);
+    }
+
+    /*!
+     * Appends all UV channels in 2D and the first color set as the
+     * uv_channels and colors fields readable by API level 1 clients.
+     */
+    void appendLegacyVertexChannels(mongo::BSONObjBuilder &builder) const;
+
+    /*!
+     * Appends UV channels and color sets, each concatenated and of
+     * getVerticesCount() elements per channel, as a vertex_channels blob.
+     * Uncompressed documents carry it only in addition to the legacy fields
+     * if these cannot hold all channels, ie for U only channels or more
+     * than one color set.
+     */
+    void appendVertexChannels(
+            const RepoBinaryView<aiVector2D> &uvChannelsData,
+            const RepoBinaryView<aiColor4D> &colorsData,
+            size_t verticesCount,
+            mongo::BSONObjBuilder &builder) const;
+
+    /*!
+     * Retrieves UV channels and color sets from a vertex_channels blob. In
+     * view mode, UV channels are borrowed if they are all 2D.
+     */
+    void retrieveVertexChannels(const mongo::BSONObj &obj, bool view);
+
+    /*!
+     * Appends tangent frames, bones and bone influences. Given the new
+     * position of every vertex, the blobs are reordered and compressed as in
+     * API level 3.
+     */
+    void appendTangentsAndBones(
+            const std::vector<uint32_t> *order,
+            mongo::BSONObjBuilder &builder) const;
+
+    //! Retrieves tangent frames, bones and bone influences.
+    void retrieveTangentsAndBones(const mongo::BSONObj &obj, bool compressed);
+
+    //! Appends API level 3 compressed vertices, faces, normals, uvs and colors.
+    void appendCompressedGeometry(mongo::BSONObjBuilder &builder) const;
+
+    //! Decodes API level 3 compressed vertices and normals.
+    void retrieveCompressedGeometry(const mongo::BSONObj &obj);
+
 protected :
 
     std::string vertexHash;
@@ -279,7 +586,11 @@ protected :
     std::vector<aiVector3t<float> >* vertices; //!< Vertices of this mesh.
 
 	//! Faces of the mesh. Each face points to several vertices by the indices.
-    std::vector<aiFace>* faces;
+	/*!
+	 * Indices of all faces are kept in a single allocation, aiFaces are only
+	 * created by toAssimp().
+	 */
+    RepoFaceBuffer* faces;
 
 	//! Normals of this mesh.
 	/*!
@@ -301,13 +612,62 @@ protected :
 	//! UV channels per vertex
 	/*!
 	 * A mesh can have multiple UV channels per vertex, each channel
-	 * is the length of the number of vertices.
+	 * is the length of the number of vertices. Channels are concatenated
+	 * one after another as in the repository.
 	 */
-    std::vector<std::vector<aiVector3t<float> >*>* uvChannels;
+    std::vector<aiVector2D>* uvChannels;
 
-    //! Vertex colors of this mesh.
+    //! Vertex colors of this mesh, color sets concatenated.
     std::vector<aiColor4D>* colors;
 
+    //! Tangents of this mesh, present only along with the bitangents.
+    std::vector<aiVector3t<float> >* tangents;
+
+    //! Bitangents of this mesh, present only along with the tangents.
+    std::vector<aiVector3t<float> >* bitangents;
+
+    //! Bone influences packed into 8 bytes per vertex.
+    std::vector<uint8_t>* boneInfluences;
+
+    //! Bones referenced by the bone influences.
+    std::vector<Bone> bones;
+
+    //! Vertices borrowed from the BSON buffer, or adopted, in view mode.
+    RepoBinaryView<aiVector3D> verticesView;
+
+    //! Normals borrowed or adopted like the vertices in view mode.
+    RepoBinaryView<aiVector3D> normalsView;
+
+    //! All UV channels concatenated, borrowed from the BSON buffer in view mode.
+    RepoBinaryView<aiVector2D> uvChannelsView;
+
+    //! Number of UV channels in uvChannels or uvChannelsView.
+    unsigned int uvChannelsCount;
+
+    //! Meaningful components of each UV channel, 2 if not given.
+    std::vector<unsigned int> uvComponents;
+
+    //! Number of color sets in colors.
+    unsigned int colorSetsCount;
+
+    //! True if vertices and normals are held in views rather than vectors.
+    bool viewMode;
+
+    //! False if the vectors have not yet been created from the views.
+    std::atomic<bool> vectorsMaterialized;
+
+    //! Guards materialization of the vectors.
+    std::mutex vectorsMutex;
+
+    //! False if the mesh has been retrieved without its geometry.
+    std::atomic<bool> geometryLoaded;
+
+    //! Loader populating geometry on first access, not owned.
+    std::atomic<RepoGeometryLoader *> geometryLoader;
+
+    //! Vertices count of the document, known before the geometry is loaded.
+    unsigned int storedVerticesCount;
+
 }; // end class
 
 
@@ -34,6 +34,8 @@ repo::core::RepoNodeTexture::RepoNodeTexture(
     , height(height) /*,
 		bitDepth(bitDepth),
 		format(format) */
+    , viewMode(false)
+    , dataMaterialized(true)
 {
     // Vector is now guaranteed to be continuous block of memory, hence it is
 	// used as a convenient way of keep track of the number of bytes pointed
@@ -53,9 +55,13 @@ repo::core::RepoNodeTexture::RepoNodeTexture(
 
 //------------------------------------------------------------------------------
 
-repo::core::RepoNodeTexture::RepoNodeTexture(const mongo::BSONObj &obj)
+repo::core::RepoNodeTexture::RepoNodeTexture(
+        const mongo::BSONObj &obj,
+        bool view)
     : RepoNodeAbstract(obj)
     , data(NULL)
+    , viewMode(view)
+    , dataMaterialized(!view)
 {
 	//
 	// Width
@@ -86,7 +92,12 @@ repo::core::RepoNodeTexture::RepoNodeTexture(const mongo::BSONObj &obj)
 	//
 	// Data
 	//
-    if (obj.hasField(REPO_LABEL_DATA) &&
+    if (view)
+        dataView = RepoTranscoderBSON::retrieveView<char>(
+            obj,
+            REPO_LABEL_DATA,
+            obj.getField(REPO_NODE_LABEL_DATA_BYTE_COUNT).numberInt());
+    else if (obj.hasField(REPO_LABEL_DATA) &&
 		obj.hasField(REPO_NODE_LABEL_DATA_BYTE_COUNT))
 	{
 
@@ -114,6 +125,26 @@ repo::core::RepoNodeTexture::~RepoNodeTexture()
 	}
 }
 
+//------------------------------------------------------------------------------
+//
+// Getters
+//
+//------------------------------------------------------------------------------
+
+const std::vector<char>* repo::core::RepoNodeTexture::getData() const
+{
+    if (!dataMaterialized)
+    {
+        std::unique_lock<std::mutex> lock(dataMutex);
+        if (!dataMaterialized)
+        {
+            const_cast<RepoNodeTexture *>(this)->data = dataView.toVector();
+            dataMaterialized = true;
+        }
+    }
+    return data;
+}
+
 //------------------------------------------------------------------------------
 //
 // Operators
@@ -170,10 +201,11 @@ mongo::BSONObj repo::core::RepoNodeTexture::toBSONObj() const
 	//
 	// Data
 	//
-	if (NULL != data && data->size() > 0)
+	RepoBinaryView<char> pixels = getDataView();
+	if (pixels.size() > 0)
 		RepoTranscoderBSON::append(
             REPO_LABEL_DATA,
-			data,
+			pixels,
 			builder,
 			REPO_NODE_LABEL_DATA_BYTE_COUNT);
 
@@ -18,6 +18,11 @@
 #include "repo_node_transformation.h"
 #include "repo_node_metadata.h"
 
+//------------------------------------------------------------------------------
+std::atomic<int> repo::core::RepoNodeTransformation::defaultMatrixEncoding(
+	repo::core::RepoNodeTransformation::ARRAY);
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 //
 // Constructors
@@ -27,10 +32,11 @@ repo::core::RepoNodeTransformation::RepoNodeTransformation(
 	const aiNode *node) :
 		RepoNodeAbstract (
 			REPO_NODE_TYPE_TRANSFORMATION,
-			REPO_NODE_API_LEVEL_1,
+			getApiLevel(getDefaultMatrixEncoding()),
             boost::uuids::random_generator()(),
 			node->mName.data),
-		matrix(node->mTransformation) {}
+		matrix(node->mTransformation),
+		matrixEncoding(getDefaultMatrixEncoding()) {}
 
 
 repo::core::RepoNodeTransformation::RepoNodeTransformation(
@@ -41,10 +47,11 @@ repo::core::RepoNodeTransformation::RepoNodeTransformation(
 	std::vector<RepoNodeAbstract *> &metadata) :
 		RepoNodeAbstract (
 			REPO_NODE_TYPE_TRANSFORMATION,
-			REPO_NODE_API_LEVEL_1,
+			getApiLevel(getDefaultMatrixEncoding()),
             boost::uuids::random_generator()(),
 			node->mName.data),
-		matrix(node->mTransformation)
+		matrix(node->mTransformation),
+		matrixEncoding(getDefaultMatrixEncoding())
 {
     //--------------------------------------------------------------------------
 	// Keep track of all allocated objects in order of creation
@@ -105,53 +112,12 @@ repo::core::RepoNodeTransformation::RepoNodeTransformation(
 
 repo::core::RepoNodeTransformation::RepoNodeTransformation(
 	const mongo::BSONObj &obj) :
-		RepoNodeAbstract(obj)
+		RepoNodeAbstract(obj),
+		matrixEncoding(ARRAY)
 {
-	if (obj.hasField(REPO_NODE_LABEL_MATRIX))
-	{
-		std::vector<float> transformationMatrix;
-
-		// matrix is stored as array of arrays
-		mongo::BSONObj matrixObj =
-			obj.getField(REPO_NODE_LABEL_MATRIX).embeddedObject();
-		std::set<std::string> mFields;
-		matrixObj.getFieldNames(mFields);
-		for(std::set<std::string>::iterator i = mFields.begin();
-			i != mFields.end(); ++i)
-		{
-			mongo::BSONObj arrayObj = matrixObj.getField(*i).embeddedObject();
-			std::set<std::string> aFields;
-			arrayObj.getFieldNames(aFields);
-			for (std::set<std::string>::iterator j = aFields.begin();
-				j != aFields.end(); ++j)
-			{
-				transformationMatrix.push_back(
-					(float) arrayObj.getField(*j).Double());
-			}
-		}
-
-		if (16 == transformationMatrix.size())
-		{
-			matrix = aiMatrix4x4 (
-				transformationMatrix[0],
-				transformationMatrix[1],
-				transformationMatrix[2],
-				transformationMatrix[3],
-				transformationMatrix[4],
-				transformationMatrix[5],
-				transformationMatrix[6],
-				transformationMatrix[7],
-				transformationMatrix[8],
-				transformationMatrix[9],
-				transformationMatrix[10],
-				transformationMatrix[11],
-				transformationMatrix[12],
-				transformationMatrix[13],
-				transformationMatrix[14],
-				transformationMatrix[15]
-			);
-		}
-	}
+	if (obj.hasField(REPO_NODE_LABEL_MATRIX) &&
+		retrieveMatrix(obj.getField(REPO_NODE_LABEL_MATRIX), matrix, matrixEncoding))
+		api = getApiLevel(matrixEncoding);
 }
 
 //------------------------------------------------------------------------------
@@ -192,21 +158,122 @@ mongo::BSONObj repo::core::RepoNodeTransformation::toBSONObj() const
 	// and optional name
 	appendDefaultFields(builder);
 
+    //--------------------------------------------------------------------------
+	// Store matrix as a single binary blob of row major values
+	if (FLOAT_BINARY == matrixEncoding)
+	{
+		float values[16];
+		for (unsigned int i = 0; i < 16; ++i)
+			values[i] = matrix[i / 4][i % 4];
+		builder.appendBinData(REPO_NODE_LABEL_MATRIX, sizeof(values),
+			mongo::BinDataGeneral, values);
+		return builder.obj();
+	}
+	else if (DOUBLE_BINARY == matrixEncoding)
+	{
+		double values[16];
+		for (unsigned int i = 0; i < 16; ++i)
+			values[i] = matrix[i / 4][i % 4];
+		builder.appendBinData(REPO_NODE_LABEL_MATRIX, sizeof(values),
+			mongo::BinDataGeneral, values);
+		return builder.obj();
+	}
+
     //--------------------------------------------------------------------------
 	// Store matrix as array of arrays
 	unsigned int matrixSize = 4;
-	mongo::BSONObjBuilder rows;
+	mongo::BSONObjBuilder rows(builder.subarrayStart(REPO_NODE_LABEL_MATRIX));
 	for (unsigned int i = 0; i < matrixSize; ++i)
 	{
-		mongo::BSONObjBuilder columns;
+		mongo::BSONObjBuilder columns(
+			rows.subarrayStart(RepoTranscoderBSON::getIndexKey(i)));
 		for (unsigned int j = 0; j < matrixSize; ++j)
-			columns << RepoTranscoderString::toString(j) << matrix[i][j];
-		rows.appendArray(RepoTranscoderString::toString(i), columns.obj());
+			columns.append(RepoTranscoderBSON::getIndexKey(j), matrix[i][j]);
+		columns.done();
 	}
-	builder.appendArray(REPO_NODE_LABEL_MATRIX, rows.obj());
+	rows.done();
 	return builder.obj();
 }
 
+//------------------------------------------------------------------------------
+//
+// Matrix encoding
+//
+//------------------------------------------------------------------------------
+repo::core::RepoNodeTransformation::MatrixEncoding
+	repo::core::RepoNodeTransformation::getDefaultMatrixEncoding()
+{
+	return (MatrixEncoding) defaultMatrixEncoding.load();
+}
+
+void repo::core::RepoNodeTransformation::setDefaultMatrixEncoding(
+	MatrixEncoding encoding)
+{
+	defaultMatrixEncoding = encoding;
+}
+
+bool repo::core::RepoNodeTransformation::retrieveMatrix(
+	const mongo::BSONElement &bse,
+	aiMatrix4x4 &matrix,
+	MatrixEncoding &encoding)
+{
+	bool success = false;
+	if (mongo::BinData == bse.type())
+	{
+		//----------------------------------------------------------------------
+		// Binary blob, size determines the precision. Copied out value by
+		// value as the blob is not guaranteed to be aligned.
+		int length = 0;
+		const char *data = bse.binData(length);
+		if (16 * sizeof(float) == (size_t) length)
+		{
+			float values[16];
+			memcpy(values, data, sizeof(values));
+			for (unsigned int i = 0; i < 16; ++i)
+				matrix[i / 4][i % 4] = values[i];
+			encoding = FLOAT_BINARY;
+			success = true;
+		}
+		else if (16 * sizeof(double) == (size_t) length)
+		{
+			double values[16];
+			memcpy(values, data, sizeof(values));
+			for (unsigned int i = 0; i < 16; ++i)
+				matrix[i / 4][i % 4] = (float) values[i];
+			encoding = DOUBLE_BINARY;
+			success = true;
+		}
+	}
+	else if (mongo::Array == bse.type())
+	{
+		//----------------------------------------------------------------------
+		// Array of arrays, elements are visited in stored order which is the
+		// order of the index keys.
+		std::vector<float> values;
+		values.reserve(16);
+		mongo::BSONObjIterator rows(bse.embeddedObject());
+		while (rows.more() && values.size() <= 16)
+		{
+			mongo::BSONElement row = rows.next();
+			if (mongo::Array != row.type())
+				break;
+			mongo::BSONObjIterator columns(row.embeddedObject());
+			while (columns.more() && values.size() <= 16)
+				values.push_back((float) columns.next().numberDouble());
+		}
+		if (16 == values.size())
+		{
+			for (unsigned int i = 0; i < 16; ++i)
+				matrix[i / 4][i % 4] = values[i];
+			encoding = ARRAY;
+			success = true;
+		}
+	}
+	return success;
+}
+
+//------------------------------------------------------------------------------
+
 void repo::core::RepoNodeTransformation::toAssimp(
 		const std::map<const RepoNodeAbstract *, unsigned int> & meshesMapping,
 		aiNode * node) const
@@ -22,6 +22,7 @@
 #include "repo_node_abstract.h"
 //------------------------------------------------------------------------------
 #include "assimp/scene.h"
+#include <atomic>
 //------------------------------------------------------------------------------
 
 namespace repo {
@@ -49,6 +50,19 @@ class REPO_CORE_EXPORT RepoNodeTransformation : public RepoNodeAbstract
 
 public :
 
+	//! Storage of the matrix in BSON.
+	/*!
+	 * ARRAY is the original array of four arrays of four doubles readable by
+	 * all clients. The binary encodings store the sixteen row major values
+	 * as a single BinDataGeneral blob of 64 bytes of floats or 128 bytes of
+	 * doubles respectively, which is considerably cheaper to encode and
+	 * decode. The encoding is recognised from the stored field on retrieval.
+	 * Clients of the original API level expect the array, hence documents
+	 * with binary matrices declare REPO_NODE_API_LEVEL_3 instead.
+	 */
+	enum MatrixEncoding { ARRAY, FLOAT_BINARY, DOUBLE_BINARY };
+
+
     //--------------------------------------------------------------------------
 	//
 	// Constructors
@@ -58,13 +72,15 @@ public :
 	inline RepoNodeTransformation() :
 		RepoNodeAbstract(
 			REPO_NODE_TYPE_TRANSFORMATION,
-            REPO_NODE_API_LEVEL_1) {}
+            getApiLevel(getDefaultMatrixEncoding())),
+		matrixEncoding(getDefaultMatrixEncoding()) {}
 
     inline RepoNodeTransformation(const std::string &name)
         : RepoNodeAbstract(REPO_NODE_TYPE_TRANSFORMATION,
-                           REPO_NODE_API_LEVEL_1,
+                           getApiLevel(getDefaultMatrixEncoding()),
                            boost::uuids::random_generator()(),
-                           name) {}
+                           name),
+          matrixEncoding(getDefaultMatrixEncoding()) {}
 
 	//! Constructs transformation scene graph node from Assimp's aiNode.
 	/*!
@@ -98,7 +114,8 @@ public :
 	//! Constructs transformation scene graph component from BSON object.
 	/*!
 	 * Same as all other components, it has to have a uuid, type, api
-	 * and optional name. In addition, stored matrix is retrieved.
+	 * and optional name. In addition, stored matrix is retrieved in any of
+	 * the supported encodings, which is then kept for serialization.
 	 *
 	 * \param obj BSON representation
 	 * \sa RepoNodeTransformation()
@@ -132,6 +149,16 @@ public :
 
     aiMatrix4x4 getMatrix() const { return matrix; }
 
+    //! Returns the encoding used by toBSONObj() for the matrix.
+    MatrixEncoding getMatrixEncoding() const { return matrixEncoding; }
+
+    //! Returns the encoding assigned to newly constructed transformations.
+    static MatrixEncoding getDefaultMatrixEncoding();
+
+    //! Returns the api level of documents storing the matrix in the encoding.
+    static unsigned int getApiLevel(MatrixEncoding encoding)
+    { return ARRAY == encoding ? REPO_NODE_API_LEVEL_1 : REPO_NODE_API_LEVEL_3; }
+
     //--------------------------------------------------------------------------
 	//
 	// Export
@@ -141,6 +168,17 @@ public :
 	//! Sets the transformation matrix.
     void setMatrix(aiMatrix4x4 matrix) { this->matrix = matrix; }
 
+	//! Sets the encoding used by toBSONObj() for the matrix and the api level.
+    void setMatrixEncoding(MatrixEncoding encoding)
+    { matrixEncoding = encoding; api = getApiLevel(encoding); }
+
+	/*!
+	 * Sets the encoding assigned to transformations constructed from now on,
+	 * ARRAY by default. Binary encodings are not readable by clients
+	 * expecting the array of arrays, hence have to be opted into.
+	 */
+    static void setDefaultMatrixEncoding(MatrixEncoding encoding);
+
 	//! BSONObj representation.
 	/*!
 	 * Returns a BSON representation of this repository object suitable for a
@@ -177,6 +215,16 @@ protected :
 
 	aiMatrix4x4 matrix; //!< transformation matrix
 
+	MatrixEncoding matrixEncoding; //!< storage of the matrix in BSON
+
+private :
+
+	//! Reads the matrix from any of the supported encodings.
+	static bool retrieveMatrix(const mongo::BSONElement &bse, aiMatrix4x4 &matrix,
+		MatrixEncoding &encoding);
+
+	static std::atomic<int> defaultMatrixEncoding;
+
 }; // end class
 
 } // end namespace core
@@ -0,0 +1,248 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_scene_decoder.h"
+#include "repo_graph_scene.h"
+#include "../repologger.h"
+#include "../primitives/reposeverity.h"
+#include "../conversion/repo_transcoder_string.h"
+
+#include <cstring>
+
+//------------------------------------------------------------------------------
+//
+// Dispatch table
+//
+//------------------------------------------------------------------------------
+
+namespace {
+
+typedef repo::core::RepoNodeAbstract *(*NodeFactory)(const mongo::BSONObj &, bool);
+
+//! Type strings and node constructors indexed by RepoSceneDecoder::NodeType.
+struct NodeDispatch
+{
+    const char *type;
+
+    NodeFactory create;
+};
+
+const NodeDispatch NODE_DISPATCH[repo::core::RepoSceneDecoder::UNKNOWN] =
+{
+    { REPO_NODE_TYPE_TRANSFORMATION,
+      [](const mongo::BSONObj &obj, bool) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeTransformation(obj); } },
+    { REPO_NODE_TYPE_MESH,
+      [](const mongo::BSONObj &obj, bool view) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeMesh(obj, view); } },
+    { REPO_NODE_TYPE_MATERIAL,
+      [](const mongo::BSONObj &obj, bool) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeMaterial(obj); } },
+    { REPO_NODE_TYPE_TEXTURE,
+      [](const mongo::BSONObj &obj, bool view) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeTexture(obj, view); } },
+    { REPO_NODE_TYPE_CAMERA,
+      [](const mongo::BSONObj &obj, bool) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeCamera(obj); } },
+    { REPO_NODE_TYPE_REFERENCE,
+      [](const mongo::BSONObj &obj, bool) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeReference(obj); } },
+    { REPO_NODE_TYPE_METADATA,
+      [](const mongo::BSONObj &obj, bool) -> repo::core::RepoNodeAbstract *
+      { return new repo::core::RepoNodeMetadata(obj); } }
+};
+
+} // end namespace
+
+//------------------------------------------------------------------------------
+//
+// Constructors
+//
+//------------------------------------------------------------------------------
+
+repo::core::RepoSceneDecoder::RepoSceneDecoder(bool view, unsigned int threads)
+    : scene(new RepoGraphScene((RepoNodeAbstract *) NULL))
+    , ownsScene(true)
+    , view(view)
+    , threads(threads)
+    , threadPool(NULL)
+    , decodedCount(0)
+    , failedCount(0)
+{}
+
+repo::core::RepoSceneDecoder::RepoSceneDecoder(
+        RepoGraphScene *scene,
+        bool view,
+        unsigned int threads)
+    : scene(scene)
+    , ownsScene(false)
+    , view(view)
+    , threads(threads)
+    , threadPool(NULL)
+    , decodedCount(0)
+    , failedCount(0)
+{}
+
+repo::core::RepoSceneDecoder::~RepoSceneDecoder()
+{
+    delete threadPool;
+    if (ownsScene)
+        delete scene;
+}
+
+//------------------------------------------------------------------------------
+//
+// Decoding
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoSceneDecoder::decode(const mongo::BSONObj &obj)
+{
+    decodeNode(obj);
+}
+
+void repo::core::RepoSceneDecoder::push(const mongo::BSONObj &obj)
+{
+    mongo::BSONObj owned = obj.getOwned();
+    getThreadPool()->submit([this, owned]() { decodeNode(owned); });
+}
+
+std::function<void(const mongo::BSONObj &)>
+    repo::core::RepoSceneDecoder::getConsumer()
+{
+    return [this](const mongo::BSONObj &obj) { push(obj); };
+}
+
+repo::core::RepoGraphScene *repo::core::RepoSceneDecoder::finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(threadPoolMutex);
+        delete threadPool;
+        threadPool = NULL;
+    }
+
+    if (failedCount > 0)
+        RepoLogger::instance().log(
+                    RepoTranscoderString::toString(failedCount.load()) +
+                    " of " +
+                    RepoTranscoderString::toString(
+                        decodedCount.load() + failedCount.load()) +
+                    " nodes failed to decode and are missing from the scene",
+                    RepoSeverity::REPO_ERROR);
+
+    scene->buildGraph(nodesBySharedID);
+    nodesBySharedID.clear();
+    ownsScene = false;
+    return scene;
+}
+
+//------------------------------------------------------------------------------
+//
+// Static helpers
+//
+//------------------------------------------------------------------------------
+
+repo::core::RepoSceneDecoder::NodeType repo::core::RepoSceneDecoder::getNodeType(
+        const mongo::BSONObj &obj)
+{
+    NodeType nodeType = UNKNOWN;
+    mongo::BSONElement bse = obj.getField(REPO_NODE_LABEL_TYPE);
+    if (mongo::String == bse.type())
+    {
+        const char *type = bse.valuestr();
+        for (int i = 0; i < UNKNOWN && UNKNOWN == nodeType; ++i)
+            if (0 == strcmp(type, NODE_DISPATCH[i].type))
+                nodeType = (NodeType) i;
+    }
+    return nodeType;
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoSceneDecoder::decodeNode(const mongo::BSONObj &obj)
+{
+    //--------------------------------------------------------------------------
+    // Scene containers indexed by node type
+    typedef void (*NodeInserter)(RepoGraphScene *, RepoNodeAbstract *);
+    static const NodeInserter inserters[UNKNOWN] =
+    {
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->transformations.insert(n); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->meshes.insert(n); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->materials.push_back(n); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n)
+        { s->textures.push_back(dynamic_cast<RepoNodeTexture *>(n)); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->cameras.push_back(n); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->references.push_back(n); },
+        [](RepoGraphScene *s, RepoNodeAbstract *n) { s->metadata.push_back(n); }
+    };
+
+    NodeType nodeType = getNodeType(obj);
+    RepoNodeAbstract *node = NULL;
+    if (UNKNOWN != nodeType)
+    {
+        try
+        {
+            node = NODE_DISPATCH[nodeType].create(obj, view);
+        }
+        catch (std::exception& e)
+        {
+            // Also std::bad_alloc of huge meshes, counted for finish()
+            RepoLogger::instance().log(
+                        "Failed to decode node: " + std::string(e.what()),
+                        RepoSeverity::REPO_ERROR);
+            ++failedCount;
+            return;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Skip objects of unrecognized type
+    if (!node)
+    {
+        std::cerr << "Unrecognized node type" << std::endl;
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(containerMutexes[nodeType]);
+        inserters[nodeType](scene, node);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(nodesMutex);
+        if (!obj.hasField(REPO_NODE_LABEL_PARENTS))
+            scene->rootNode = node;
+        scene->nodesByUniqueID.insert(std::make_pair(node->getUniqueID(), node));
+        // TODO: take care of multiple objects that have the same shared ID.
+        nodesBySharedID.insert(std::make_pair(node->getSharedID(), node));
+    }
+    ++decodedCount;
+}
+
+repo::core::RepoThreadPool *repo::core::RepoSceneDecoder::getThreadPool()
+{
+    std::unique_lock<std::mutex> lock(threadPoolMutex);
+    if (!threadPool)
+        threadPool = threads > 0
+                ? new RepoThreadPool(threads)
+                : new RepoThreadPool();
+    return threadPool;
+}
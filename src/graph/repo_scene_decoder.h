@@ -0,0 +1,181 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_SCENE_DECODER_H
+#define REPO_SCENE_DECODER_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <functional>
+//------------------------------------------------------------------------------
+#include <mongo/client/dbclient.h> // the MongoDB driver
+#include <boost/uuid/uuid.hpp>
+//------------------------------------------------------------------------------
+#include "repo_node_abstract.h"
+#include "../primitives/repothreadpool.h"
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+class RepoGraphScene;
+
+//! Incremental decoder of BSON documents into a scene graph.
+/*!
+ * Documents can be passed in one by one as they arrive from a cursor, eg via
+ * getConsumer() given to MongoClientWrapper::fetchEntireCollection(), so that
+ * node construction overlaps with network I/O. Each document is dispatched on
+ * its node type, interned once from the type string, to the matching node
+ * constructor and scene container. Queued documents are decoded on a pool
+ * of worker threads, each scene container being guarded by its own mutex.
+ * The parental graph is built only once all documents have been decoded.
+ *
+ * Node order within the scene vectors follows completion order when decoding
+ * on the pool, not the order of the documents.
+ */
+class REPO_CORE_EXPORT RepoSceneDecoder
+{
+
+public:
+
+    //! Node types known to the decoder, UNKNOWN is also the number of types.
+    enum NodeType
+    {
+        TRANSFORMATION,
+        MESH,
+        MATERIAL,
+        TEXTURE,
+        CAMERA,
+        REFERENCE,
+        METADATA,
+        UNKNOWN
+    };
+
+public:
+
+    /*!
+     * Decodes into a new scene which is owned by the decoder until released
+     * by finish(). If threads is 0, the default size of the thread pool is
+     * used. In view mode, meshes and textures borrow their binary data from
+     * the documents, see RepoGraphScene::RepoGraphScene().
+     */
+    RepoSceneDecoder(bool view = false, unsigned int threads = 0);
+
+    //! Decodes into the given empty scene which has to outlive the decoder.
+    RepoSceneDecoder(
+            RepoGraphScene *scene,
+            bool view = false,
+            unsigned int threads = 0);
+
+    //! Waits for queued documents and deletes the scene if still owned.
+    ~RepoSceneDecoder();
+
+    //--------------------------------------------------------------------------
+    //
+    // Decoding
+    //
+    //--------------------------------------------------------------------------
+
+    //! Decodes the document on the calling thread.
+    void decode(const mongo::BSONObj &obj);
+
+    /*!
+     * Queues an owned copy of the document to be decoded on the pool. Can be
+     * called from multiple threads.
+     */
+    void push(const mongo::BSONObj &obj);
+
+    //! Returns a consumer queueing documents via push().
+    std::function<void(const mongo::BSONObj &)> getConsumer();
+
+    /*!
+     * Waits for all queued documents, builds the parental graph and returns
+     * the scene. Ownership of a scene created by the decoder passes to the
+     * caller. No documents can be decoded afterwards. Logs an error if any
+     * of the nodes failed to decode, see getFailedCount().
+     */
+    RepoGraphScene *finish();
+
+    //! Returns the number of documents decoded into nodes so far.
+    unsigned long long getDecodedCount() const { return decodedCount; }
+
+    /*!
+     * Returns the number of documents of a known type whose node constructor
+     * threw, eg on malformed BSON or running out of memory. These nodes are
+     * missing from the scene. Documents of unknown type are not counted.
+     */
+    unsigned long long getFailedCount() const { return failedCount; }
+
+    //--------------------------------------------------------------------------
+    //
+    // Static helpers
+    //
+    //--------------------------------------------------------------------------
+
+    //! Returns the node type of the document without copying the type string.
+    static NodeType getNodeType(const mongo::BSONObj &obj);
+
+private:
+
+    RepoSceneDecoder(const RepoSceneDecoder &);
+
+    RepoSceneDecoder &operator=(const RepoSceneDecoder &);
+
+    //! Creates the node and inserts it into the scene.
+    void decodeNode(const mongo::BSONObj &obj);
+
+    //! Returns the thread pool, starting it on first use.
+    RepoThreadPool *getThreadPool();
+
+private:
+
+    //! Scene being populated.
+    RepoGraphScene *scene;
+
+    //! True if the scene has been created by and not yet released from this.
+    bool ownsScene;
+
+    bool view;
+
+    unsigned int threads;
+
+    //! Workers decoding queued documents, NULL until the first push().
+    RepoThreadPool *threadPool;
+
+    //! Guards the thread pool creation.
+    std::mutex threadPoolMutex;
+
+    //! One mutex per scene container indexed by node type.
+    std::mutex containerMutexes[UNKNOWN];
+
+    //! Guards the root node and the lookup maps.
+    std::mutex nodesMutex;
+
+    //! Nodes by their shared IDs used to build the graph at the end.
+    std::map<boost::uuids::uuid, RepoNodeAbstract *> nodesBySharedID;
+
+    std::atomic<unsigned long long> decodedCount;
+
+    std::atomic<unsigned long long> failedCount;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_SCENE_DECODER_H
@@ -0,0 +1,203 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongobatchwriter.h"
+#include "repologger.h"
+#include "primitives/reposeverity.h"
+
+#include <algorithm>
+#include <memory>
+
+//------------------------------------------------------------------------------
+const unsigned int repo::core::MongoBatchWriter::MAX_BATCH_DOCUMENTS = 1000;
+const unsigned int repo::core::MongoBatchWriter::MAX_BATCH_BYTES = 16 * 1024 * 1024;
+//------------------------------------------------------------------------------
+
+repo::core::MongoBatchWriter::MongoBatchWriter(
+        MongoClientWrapper &connection,
+        const std::string &database,
+        const std::string &collection)
+    : connection(&connection)
+    , pool(NULL)
+    , threadPool(NULL)
+    , database(database)
+    , collection(collection)
+    , maxInFlight(1)
+    , batchBytes(0)
+    , inFlight(0)
+    , documentsCount(0)
+    , bytesCount(0)
+    , batchesCount(0)
+    , failedBatchesCount(0)
+    , started(false) {}
+
+repo::core::MongoBatchWriter::MongoBatchWriter(
+        MongoClientPool &pool,
+        const std::string &database,
+        const std::string &collection,
+        unsigned int maxInFlight)
+    : connection(NULL)
+    , pool(&pool)
+    , threadPool(NULL)
+    , database(database)
+    , collection(collection)
+    , maxInFlight(maxInFlight > 0 ? maxInFlight : std::max(1u, pool.size()))
+    , batchBytes(0)
+    , inFlight(0)
+    , documentsCount(0)
+    , bytesCount(0)
+    , batchesCount(0)
+    , failedBatchesCount(0)
+    , started(false)
+{
+    threadPool = new RepoThreadPool(this->maxInFlight);
+}
+
+repo::core::MongoBatchWriter::~MongoBatchWriter()
+{
+    flush();
+    delete threadPool;
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::MongoBatchWriter::insert(const mongo::BSONObj &obj)
+{
+    if (!started)
+    {
+        start = std::chrono::steady_clock::now();
+        started = true;
+    }
+
+    const unsigned long long size = obj.objsize();
+    if (!batch.empty() && (batch.size() >= MAX_BATCH_DOCUMENTS
+                           || batchBytes + size > MAX_BATCH_BYTES))
+        send();
+
+    batch.push_back(obj.getOwned());
+    batchBytes += size;
+}
+
+void repo::core::MongoBatchWriter::insert(const std::vector<mongo::BSONObj> &objs)
+{
+    for (unsigned int i = 0; i < objs.size(); ++i)
+        insert(objs[i]);
+}
+
+bool repo::core::MongoBatchWriter::flush()
+{
+    send();
+    if (threadPool)
+        threadPool->wait();
+    return failedBatchesCount == 0;
+}
+
+//------------------------------------------------------------------------------
+
+double repo::core::MongoBatchWriter::getElapsedSeconds() const
+{
+    double seconds = 0;
+    if (started)
+        seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+    return seconds;
+}
+
+double repo::core::MongoBatchWriter::getDocumentsPerSecond() const
+{
+    double seconds = getElapsedSeconds();
+    return seconds > 0 ? documentsCount / seconds : 0;
+}
+
+double repo::core::MongoBatchWriter::getMegabytesPerSecond() const
+{
+    double seconds = getElapsedSeconds();
+    return seconds > 0 ? bytesCount / (1024.0 * 1024.0) / seconds : 0;
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+void repo::core::MongoBatchWriter::send()
+{
+    if (batch.empty())
+        return;
+
+    if (connection)
+        write(*connection, batch, batchBytes);
+    else
+    {
+        //----------------------------------------------------------------------
+        // Throttle to maxInFlight batches so that memory stays bounded.
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (inFlight >= maxInFlight)
+                batchSent.wait(lock);
+            ++inFlight;
+        }
+
+        std::shared_ptr<std::vector<mongo::BSONObj> > sending(
+                    new std::vector<mongo::BSONObj>());
+        sending->swap(batch);
+        const unsigned long long sendingBytes = batchBytes;
+        threadPool->submit([this, sending, sendingBytes]()
+        {
+            // Nothing may escape, the future is discarded and flush() waits
+            // for inFlight to drop.
+            try
+            {
+                MongoClientPool::ScopedConnection pooled(*pool);
+                if (pooled.get())
+                    write(*pooled, *sending, sendingBytes);
+                else
+                    ++failedBatchesCount;
+            }
+            catch (std::exception &e)
+            {
+                ++failedBatchesCount;
+                RepoLogger::instance().log(
+                            std::string(e.what()), RepoSeverity::REPO_DEBUG);
+            }
+            catch (...)
+            {
+                ++failedBatchesCount;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                --inFlight;
+            }
+            batchSent.notify_one();
+        });
+    }
+    batch.clear();
+    batchBytes = 0;
+}
+
+void repo::core::MongoBatchWriter::write(
+        MongoClientWrapper &target,
+        const std::vector<mongo::BSONObj> &objs,
+        unsigned long long objsBytes)
+{
+    if (!target.insertRecords(database, collection, objs))
+        ++failedBatchesCount;
+    ++batchesCount;
+    documentsCount += objs.size();
+    bytesCount += objsBytes;
+}
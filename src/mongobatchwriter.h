@@ -0,0 +1,187 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MONGOBATCHWRITER_H
+#define MONGOBATCHWRITER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+//------------------------------------------------------------------------------
+#include <mongo/client/dbclient.h> // mongo c++ driver
+#include <mongo/bson/bson.h>
+//------------------------------------------------------------------------------
+#include "mongoclientwrapper.h"
+#include "mongoclientpool.h"
+#include "primitives/repothreadpool.h"
+
+#include "repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//! Buffered writer grouping documents into unordered bulk inserts.
+/*!
+ * Documents are accumulated into batches of up to MAX_BATCH_DOCUMENTS
+ * documents or MAX_BATCH_BYTES bytes, whichever is hit first, and each batch
+ * is sent as a single insert message with continue on error. When created
+ * over a connection pool, up to maxInFlight batches are being sent at the same
+ * time, each on its own connection. Errors are reported per batch.
+ */
+class REPO_CORE_EXPORT MongoBatchWriter
+{
+
+public:
+
+    //! Maximum number of documents in a single batch.
+    static const unsigned int MAX_BATCH_DOCUMENTS;
+
+    //! Maximum size of all documents in a single batch (16MB).
+    static const unsigned int MAX_BATCH_BYTES;
+
+public:
+
+    //! Writer sending each batch synchronously over a single connection.
+    MongoBatchWriter(
+            MongoClientWrapper &connection,
+            const std::string &database,
+            const std::string &collection);
+
+    /*! Writer pipelining up to maxInFlight batches over connections of the
+     * pool. If maxInFlight is 0, the size of the pool is used.
+     */
+    MongoBatchWriter(
+            MongoClientPool &pool,
+            const std::string &database,
+            const std::string &collection,
+            unsigned int maxInFlight = 0);
+
+    //! Flushes all pending documents.
+    ~MongoBatchWriter();
+
+    //--------------------------------------------------------------------------
+    //
+    // Writing
+    //
+    //--------------------------------------------------------------------------
+
+    //! Queues a document for insertion, sends the batch once full.
+    void insert(const mongo::BSONObj &obj);
+
+    //! Queues all documents for insertion.
+    void insert(const std::vector<mongo::BSONObj> &objs);
+
+    /*! Sends the pending batch and waits for all batches in flight. Returns
+     * true if no batch failed so far, false otherwise.
+     */
+    bool flush();
+
+    //--------------------------------------------------------------------------
+    //
+    // Counters
+    //
+    //--------------------------------------------------------------------------
+
+    //! Returns the number of documents sent so far.
+    unsigned long long getDocumentsCount() const { return documentsCount; }
+
+    //! Returns the number of BSON bytes sent so far.
+    unsigned long long getBytesCount() const { return bytesCount; }
+
+    //! Returns the number of batches sent so far.
+    unsigned long long getBatchesCount() const { return batchesCount; }
+
+    //! Returns the number of batches that reported an error.
+    unsigned long long getFailedBatchesCount() const { return failedBatchesCount; }
+
+    //! Returns seconds elapsed since the first document was queued.
+    double getElapsedSeconds() const;
+
+    //! Returns the number of documents sent per second.
+    double getDocumentsPerSecond() const;
+
+    //! Returns the number of megabytes sent per second.
+    double getMegabytesPerSecond() const;
+
+private:
+
+    MongoBatchWriter(const MongoBatchWriter &);
+
+    MongoBatchWriter &operator=(const MongoBatchWriter &);
+
+    //! Sends the pending batch, blocks if maxInFlight batches are being sent.
+    void send();
+
+    //! Inserts the batch using given connection and updates counters.
+    void write(
+            MongoClientWrapper &target,
+            const std::vector<mongo::BSONObj> &objs,
+            unsigned long long objsBytes);
+
+private:
+
+    //! Single connection, NULL if writing over a pool.
+    MongoClientWrapper *connection;
+
+    //! Connection pool, NULL if writing over a single connection.
+    MongoClientPool *pool;
+
+    //! Threads sending batches, NULL if writing over a single connection.
+    RepoThreadPool *threadPool;
+
+    std::string database;
+
+    std::string collection;
+
+    unsigned int maxInFlight;
+
+    //! Documents of the batch being accumulated.
+    std::vector<mongo::BSONObj> batch;
+
+    //! Size of the documents of the batch being accumulated.
+    unsigned long long batchBytes;
+
+    //! Number of batches currently being sent.
+    unsigned int inFlight;
+
+    std::mutex mutex;
+
+    std::condition_variable batchSent;
+
+    std::atomic<unsigned long long> documentsCount;
+
+    std::atomic<unsigned long long> bytesCount;
+
+    std::atomic<unsigned long long> batchesCount;
+
+    std::atomic<unsigned long long> failedBatchesCount;
+
+    //! Time when the first document was queued.
+    std::chrono::steady_clock::time_point start;
+
+    bool started;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // MONGOBATCHWRITER_H
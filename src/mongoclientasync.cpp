@@ -0,0 +1,262 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongoclientasync.h"
+#include "repologger.h"
+#include "primitives/reposeverity.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+//
+// Token
+//
+//------------------------------------------------------------------------------
+
+repo::core::MongoClientAsync::Token::Token()
+    : state(new State())
+{
+    state->cancelled = false;
+    state->hasDeadline = false;
+}
+
+repo::core::MongoClientAsync::Token::Token(
+        const std::chrono::milliseconds &timeout)
+    : state(new State())
+{
+    state->cancelled = false;
+    state->hasDeadline = true;
+    state->deadline = std::chrono::steady_clock::now() + timeout;
+}
+
+bool repo::core::MongoClientAsync::Token::isCancelled() const
+{
+    return state->cancelled || isExpired();
+}
+
+bool repo::core::MongoClientAsync::Token::isExpired() const
+{
+    return state->hasDeadline &&
+            std::chrono::steady_clock::now() >= state->deadline;
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructor
+//
+//------------------------------------------------------------------------------
+
+repo::core::MongoClientAsync::MongoClientAsync(
+        MongoClientPool &pool,
+        unsigned int threads)
+    : pool(pool)
+{
+    threadPool = new RepoThreadPool(threads > 0 ? threads : std::max(1u, pool.size()));
+}
+
+repo::core::MongoClientAsync::~MongoClientAsync()
+{
+    delete threadPool;
+}
+
+//------------------------------------------------------------------------------
+//
+// Requests
+//
+//------------------------------------------------------------------------------
+
+std::future<mongo::BSONObj> repo::core::MongoClientAsync::findOneByUniqueID(
+        const std::string &database,
+        const std::string &collection,
+        const std::string &uuid,
+        const std::list<std::string> &fields,
+        const Token &token)
+{
+    return submit<mongo::BSONObj>(
+                [database, collection, uuid, fields](MongoClientWrapper &connection)
+    {
+        return connection.findOneByUniqueID(
+                    database, collection, uuid, fields).getOwned();
+    }, token);
+}
+
+std::future<mongo::BSONObj> repo::core::MongoClientAsync::findOneBySharedID(
+        const std::string &database,
+        const std::string &collection,
+        const std::string &uuid,
+        const std::string &sortField,
+        const std::list<std::string> &fields,
+        const Token &token)
+{
+    return submit<mongo::BSONObj>(
+                [database, collection, uuid, sortField, fields](MongoClientWrapper &connection)
+    {
+        return connection.findOneBySharedID(
+                    database, collection, uuid, sortField, fields).getOwned();
+    }, token);
+}
+
+std::future<std::vector<mongo::BSONObj> >
+    repo::core::MongoClientAsync::findAllByUniqueIDs(
+        const std::string &database,
+        const std::string &collection,
+        const mongo::BSONArray &array,
+        const Token &token)
+{
+    mongo::BSONArray ids(array.getOwned());
+    return submit<std::vector<mongo::BSONObj> >(
+                [database, collection, ids, token](MongoClientWrapper &connection)
+    {
+        std::vector<mongo::BSONObj> objs;
+        try
+        {
+            std::auto_ptr<mongo::DBClientCursor> cursor =
+                    connection.findAllByUniqueIDs(database, collection, ids, 0);
+            while (cursor.get() && cursor->more() && isRunnable(token))
+                objs.push_back(cursor->next().getOwned());
+        }
+        catch (mongo::DBException& e)
+        {
+            log(std::string(e.what()));
+        }
+        return objs;
+    }, token);
+}
+
+std::future<std::vector<mongo::BSONObj> >
+    repo::core::MongoClientAsync::fetchEntireCollection(
+        const std::string &database,
+        const std::string &collection,
+        const Token &token)
+{
+    // Not via submit() as a failed exhaust cursor leaves unread replies on
+    // the connection, which therefore has to be discarded, not released.
+    MongoClientPool *connections = &pool;
+    return threadPool->submit([connections, database, collection, token]()
+    {
+        std::vector<mongo::BSONObj> objs;
+        if (!isRunnable(token))
+            return objs;
+
+        MongoClientPool::ScopedConnection connection(*connections);
+        if (!connection.get() || !isRunnable(token))
+            return objs;
+
+        // The exhaust cursor cannot be abandoned half way through without
+        // leaving the connection unusable, hence the token is checked only
+        // to skip copying the remaining documents.
+        bool success = connection->fetchEntireCollection(
+                    database,
+                    collection,
+                    [&objs, &token](const mongo::BSONObj &obj)
+        {
+            if (!token.isCancelled())
+                objs.push_back(obj.getOwned());
+        });
+        if (!success)
+        {
+            connection.discard();
+            objs.clear();
+        }
+        return isRunnable(token) ? objs : std::vector<mongo::BSONObj>();
+    });
+}
+
+std::future<mongo::BSONObj> repo::core::MongoClientAsync::runCommand(
+        const std::string &database,
+        const mongo::BSONObj &command,
+        const Token &token)
+{
+    mongo::BSONObj cmd = command.getOwned();
+    return submit<mongo::BSONObj>(
+                [database, cmd](MongoClientWrapper &connection)
+    {
+        return connection.runCommand(database, cmd).getOwned();
+    }, token);
+}
+
+std::future<repo::core::RepoCollStats>
+    repo::core::MongoClientAsync::getCollectionStats(
+        const std::string &database,
+        const std::string &collection,
+        const Token &token)
+{
+    return submit<RepoCollStats>(
+                [database, collection](MongoClientWrapper &connection)
+    {
+        return connection.getCollectionStats(database, collection);
+    }, token);
+}
+
+std::future<unsigned long long>
+    repo::core::MongoClientAsync::countItemsInCollection(
+        const std::string &database,
+        const std::string &collection,
+        const Token &token)
+{
+    return submit<unsigned long long>(
+                [database, collection](MongoClientWrapper &connection)
+    {
+        return connection.countItemsInCollection(database, collection);
+    }, token, 0);
+}
+
+std::future<bool> repo::core::MongoClientAsync::insertRecords(
+        const std::string &database,
+        const std::string &collection,
+        const std::vector<mongo::BSONObj> &objs,
+        const Token &token)
+{
+    std::shared_ptr<std::vector<mongo::BSONObj> > owned(
+                new std::vector<mongo::BSONObj>());
+    owned->reserve(objs.size());
+    for (unsigned int i = 0; i < objs.size(); ++i)
+        owned->push_back(objs[i].getOwned());
+
+    return submit<bool>(
+                [database, collection, owned](MongoClientWrapper &connection)
+    {
+        return connection.insertRecords(database, collection, *owned);
+    }, token, false);
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientAsync::isRunnable(const Token &token)
+{
+    bool runnable = true;
+    if (token.isExpired())
+    {
+        log("Request deadline exceeded.");
+        runnable = false;
+    }
+    else if (token.isCancelled())
+    {
+        log("Request cancelled.");
+        runnable = false;
+    }
+    return runnable;
+}
+
+void repo::core::MongoClientAsync::log(const std::string &message)
+{
+    RepoLogger::instance().log(message, RepoSeverity::REPO_DEBUG);
+}
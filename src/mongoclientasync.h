@@ -0,0 +1,259 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MONGOCLIENTASYNC_H
+#define MONGOCLIENTASYNC_H
+
+#include <vector>
+#include <list>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <future>
+#include <functional>
+//------------------------------------------------------------------------------
+#include <mongo/client/dbclient.h> // mongo c++ driver
+#include <mongo/bson/bson.h>
+//------------------------------------------------------------------------------
+#include "mongoclientwrapper.h"
+#include "mongoclientpool.h"
+#include "primitives/repothreadpool.h"
+#include "primitives/repocollstats.h"
+
+#include "repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//! Asynchronous facade over a pool of MongoDB connections.
+/*!
+ * Each request is executed on a dedicated I/O thread pool using a connection
+ * acquired from the connection pool for the duration of the request, so that
+ * the caller can overlap other work, eg Assimp parsing and BSON encoding,
+ * with network traffic. Results are delivered either as futures or via
+ * completion callbacks invoked on the I/O thread.
+ *
+ * Requests can be cancelled or given a deadline through a Token. Both are
+ * checked before the request is sent and, for requests streaming multiple
+ * documents, between the documents. A blocking driver call which is already
+ * in progress is not interrupted. Cancelled and expired requests are logged
+ * and yield a default constructed result, in the same way failed requests do.
+ */
+class REPO_CORE_EXPORT MongoClientAsync
+{
+
+public:
+
+    //! Cancellation token shared by copies, optionally carrying a deadline.
+    class REPO_CORE_EXPORT Token
+    {
+
+    public:
+
+        //! Token without a deadline.
+        Token();
+
+        //! Token expiring after given timeout from now.
+        explicit Token(const std::chrono::milliseconds &timeout);
+
+        //! Cancels all requests sharing this token.
+        void cancel() { state->cancelled = true; }
+
+        //! Returns true if cancelled or past the deadline.
+        bool isCancelled() const;
+
+        //! Returns true if past the deadline.
+        bool isExpired() const;
+
+    private:
+
+        struct State
+        {
+            std::atomic<bool> cancelled;
+
+            bool hasDeadline;
+
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        std::shared_ptr<State> state;
+
+    }; // end Token
+
+public:
+
+    /*! Runs requests on given number of I/O threads over connections of the
+     * pool. If threads is 0, the size of the pool is used. The pool has to
+     * outlive this object.
+     */
+    MongoClientAsync(MongoClientPool &pool, unsigned int threads = 0);
+
+    //! Waits for all queued requests to finish.
+    ~MongoClientAsync();
+
+    //--------------------------------------------------------------------------
+    //
+    // Generic
+    //
+    //--------------------------------------------------------------------------
+
+    /*!
+     * Queues an arbitrary request to be executed on a pooled connection.
+     * Returns defaultValue if the request is cancelled, expired or no
+     * connection is available.
+     */
+    template <typename Result>
+    std::future<Result> submit(
+            const std::function<Result(MongoClientWrapper &)> &request,
+            const Token &token = Token(),
+            const Result &defaultValue = Result())
+    {
+        MongoClientPool *connections = &pool;
+        return threadPool->submit([connections, request, token, defaultValue]()
+        {
+            Result result = defaultValue;
+            if (!isRunnable(token))
+                return result;
+
+            MongoClientPool::ScopedConnection connection(*connections);
+            if (connection.get() && isRunnable(token))
+                result = request(*connection);
+            return result;
+        });
+    }
+
+    //! Queues a request and passes its result to the callback once done.
+    template <typename Result>
+    void submit(
+            const std::function<Result(MongoClientWrapper &)> &request,
+            const std::function<void(const Result &)> &callback,
+            const Token &token = Token(),
+            const Result &defaultValue = Result())
+    {
+        MongoClientPool *connections = &pool;
+        threadPool->submit([connections, request, callback, token, defaultValue]()
+        {
+            Result result = defaultValue;
+            if (isRunnable(token))
+            {
+                MongoClientPool::ScopedConnection connection(*connections);
+                if (connection.get() && isRunnable(token))
+                    result = request(*connection);
+            }
+            callback(result);
+        });
+    }
+
+    //! Blocks until all queued requests have finished.
+    void wait() { threadPool->wait(); }
+
+    //--------------------------------------------------------------------------
+    //
+    // Requests
+    //
+    //--------------------------------------------------------------------------
+
+    //! Asynchronous MongoClientWrapper::findOneByUniqueID().
+    std::future<mongo::BSONObj> findOneByUniqueID(
+            const std::string &database,
+            const std::string &collection,
+            const std::string &uuid,
+            const std::list<std::string> &fields = std::list<std::string>(),
+            const Token &token = Token());
+
+    //! Asynchronous MongoClientWrapper::findOneBySharedID().
+    std::future<mongo::BSONObj> findOneBySharedID(
+            const std::string &database,
+            const std::string &collection,
+            const std::string &uuid,
+            const std::string &sortField,
+            const std::list<std::string> &fields = std::list<std::string>(),
+            const Token &token = Token());
+
+    /*! Retrieves all objects whose ID is in the array. The cursor is drained
+     * on the I/O thread as it is bound to the pooled connection.
+     */
+    std::future<std::vector<mongo::BSONObj> > findAllByUniqueIDs(
+            const std::string &database,
+            const std::string &collection,
+            const mongo::BSONArray &array,
+            const Token &token = Token());
+
+    /*!
+     * Retrieves all objects of the collection. Yields no objects if the query
+     * failed midway, the connection is then replaced in the pool.
+     */
+    std::future<std::vector<mongo::BSONObj> > fetchEntireCollection(
+            const std::string &database,
+            const std::string &collection,
+            const Token &token = Token());
+
+    //! Asynchronous MongoClientWrapper::runCommand().
+    std::future<mongo::BSONObj> runCommand(
+            const std::string &database,
+            const mongo::BSONObj &command,
+            const Token &token = Token());
+
+    //! Asynchronous MongoClientWrapper::getCollectionStats().
+    std::future<RepoCollStats> getCollectionStats(
+            const std::string &database,
+            const std::string &collection,
+            const Token &token = Token());
+
+    //! Asynchronous MongoClientWrapper::countItemsInCollection().
+    std::future<unsigned long long> countItemsInCollection(
+            const std::string &database,
+            const std::string &collection,
+            const Token &token = Token());
+
+    /*! Asynchronous MongoClientWrapper::insertRecords(). The objects are
+     * owned by the request, hence the caller can reuse its vector straight
+     * away.
+     */
+    std::future<bool> insertRecords(
+            const std::string &database,
+            const std::string &collection,
+            const std::vector<mongo::BSONObj> &objs,
+            const Token &token = Token());
+
+private:
+
+    MongoClientAsync(const MongoClientAsync &);
+
+    MongoClientAsync &operator=(const MongoClientAsync &);
+
+    //! Returns false and logs if the token is cancelled or expired.
+    static bool isRunnable(const Token &token);
+
+    //! Logs messages using the repo logger.
+    static void log(const std::string &message);
+
+private:
+
+    MongoClientPool &pool;
+
+    //! I/O threads executing the requests.
+    RepoThreadPool *threadPool;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // MONGOCLIENTASYNC_H
@@ -0,0 +1,291 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongoclientpool.h"
+#include "conversion/repo_transcoder_string.h"
+#include "repologger.h"
+#include "primitives/reposeverity.h"
+#include "primitives/repothreadpool.h"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+//------------------------------------------------------------------------------
+
+unsigned int repo::core::MongoClientPool::getDefaultSize()
+{
+    return RepoThreadPool::getDefaultSize();
+}
+
+repo::core::MongoClientPool::MongoClientPool(
+        const MongoClientWrapper &prototype,
+        unsigned int size)
+    : prototype(prototype)
+    , requestedSize(size)
+{
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        MongoClientWrapper *connection = new MongoClientWrapper(prototype);
+        if (connection->reconnectAndReauthenticate())
+            connections.push_back(connection);
+        else
+        {
+            log("Connection " + RepoTranscoderString::toString(i) +
+                " to " + prototype.getHostAndPort() + " failed.");
+            delete connection;
+        }
+    }
+    available = connections;
+}
+
+repo::core::MongoClientPool::~MongoClientPool()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (available.size() != connections.size())
+        log("Destroying connection pool with connections still in use.");
+    for (unsigned int i = 0; i < connections.size(); ++i)
+        delete connections[i];
+    connections.clear();
+    available.clear();
+}
+
+//------------------------------------------------------------------------------
+
+repo::core::MongoClientWrapper *repo::core::MongoClientPool::acquire()
+{
+    MongoClientWrapper *connection = NULL;
+    std::unique_lock<std::mutex> lock(mutex);
+    // Discarded connections may empty the pool while waiting
+    while (available.empty() && !connections.empty())
+        connectionReleased.wait(lock);
+    if (!available.empty())
+    {
+        connection = available.back();
+        available.pop_back();
+    }
+    return connection;
+}
+
+void repo::core::MongoClientPool::release(MongoClientWrapper *connection)
+{
+    if (connection)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.push_back(connection);
+        }
+        connectionReleased.notify_one();
+    }
+}
+
+void repo::core::MongoClientPool::discard(MongoClientWrapper *connection)
+{
+    if (connection)
+    {
+        MongoClientWrapper *replacement = new MongoClientWrapper(prototype);
+        if (!replacement->reconnectAndReauthenticate())
+        {
+            log("Replacement connection to " + prototype.getHostAndPort() +
+                " failed.");
+            delete replacement;
+            replacement = NULL;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::vector<MongoClientWrapper *>::iterator it = std::find(
+                        connections.begin(), connections.end(), connection);
+            if (connections.end() != it)
+            {
+                if (replacement)
+                    *it = replacement;
+                else
+                    connections.erase(it);
+            }
+            if (replacement)
+                available.push_back(replacement);
+        }
+        delete connection;
+        connectionReleased.notify_all();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientPool::fetchEntireCollection(
+        const std::string &database,
+        const std::string &collection,
+        std::vector<mongo::BSONObj> &ret)
+{
+    const std::string ns =
+            MongoClientWrapper::getNamespace(database, collection);
+    const unsigned int uuidRangesCount = std::max(1u, size());
+    const unsigned int rangesCount = uuidRangesCount + 1;
+
+    //--------------------------------------------------------------------------
+    // Split the first byte of the UUID space into equal ranges, followed by
+    // a range of all other _id values, and count documents in each so that
+    // every thread can write into its own slice of a single pre-sized vector.
+    std::vector<mongo::BSONObj> queries(rangesCount);
+    std::vector<unsigned long long> offsets(rangesCount + 1, 0);
+    {
+        ScopedConnection connection(*this);
+        if (!connection.get())
+            return false;
+        for (unsigned int i = 0; i < rangesCount; ++i)
+        {
+            queries[i] = i < uuidRangesCount
+                    ? uuidRangeQuery(
+                          (i * 256) / uuidRangesCount,
+                          ((i + 1) * 256) / uuidRangesCount)
+                    : nonUUIDQuery();
+            unsigned long long count = 0;
+            try
+            {
+                count = connection->clientConnection.count(ns, queries[i]);
+            }
+            catch (mongo::DBException& e)
+            {
+                log(std::string(e.what()));
+                return false;
+            }
+            offsets[i + 1] = offsets[i] + count;
+        }
+    }
+
+    const size_t start = ret.size();
+    ret.resize(start + offsets[rangesCount]);
+
+    //--------------------------------------------------------------------------
+    // Documents inserted in the meantime do not fit into the counted slices,
+    // they are collected separately and appended at the end.
+    std::vector<unsigned long long> retrieved(rangesCount, 0);
+    std::vector<std::vector<mongo::BSONObj> > overflows(rangesCount);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < rangesCount; ++i)
+    {
+        threads.push_back(std::thread([&, i]()
+        {
+            ScopedConnection connection(*this);
+            if (!connection.get())
+            {
+                failed = true;
+                return;
+            }
+            try
+            {
+                std::auto_ptr<mongo::DBClientCursor> cursor =
+                        connection->clientConnection.query(
+                            ns,
+                            mongo::Query(queries[i]),
+                            0,
+                            0,
+                            NULL,
+                            mongo::QueryOption_Exhaust);
+                const unsigned long long capacity = offsets[i + 1] - offsets[i];
+                while (cursor.get() && cursor->more())
+                {
+                    if (retrieved[i] < capacity)
+                        ret[start + offsets[i] + retrieved[i]++] =
+                                cursor->next().copy();
+                    else
+                        overflows[i].push_back(cursor->next().copy());
+                }
+            }
+            catch (mongo::DBException& e)
+            {
+                // Unread exhaust replies would reach the next user
+                log(std::string(e.what()));
+                connection.discard();
+                failed = true;
+            }
+        }));
+    }
+    for (unsigned int i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    // A partial collection would silently yield a partial scene
+    if (failed)
+    {
+        ret.resize(start);
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    // Close gaps left by documents deleted in the meantime and append overflow.
+    size_t end = start;
+    for (unsigned int i = 0; i < rangesCount; ++i)
+    {
+        for (unsigned long long j = 0; j < retrieved[i]; ++j, ++end)
+            if (end != start + offsets[i] + j)
+                ret[end] = ret[start + offsets[i] + j];
+    }
+    ret.resize(end);
+    for (unsigned int i = 0; i < rangesCount; ++i)
+        ret.insert(ret.end(), overflows[i].begin(), overflows[i].end());
+
+    return ret.size() > start;
+}
+
+//------------------------------------------------------------------------------
+
+mongo::BSONObj repo::core::MongoClientPool::uuidRangeQuery(
+        unsigned int first,
+        unsigned int last)
+{
+    unsigned char bound[16];
+    mongo::BSONObjBuilder range;
+
+    memset(bound, 0, sizeof(bound));
+    bound[0] = (unsigned char) first;
+    range.appendBinData("$gte", sizeof(bound), mongo::bdtUUID, bound);
+
+    if (last < 256)
+    {
+        bound[0] = (unsigned char) last;
+        range.appendBinData("$lt", sizeof(bound), mongo::bdtUUID, bound);
+    }
+    else
+    {
+        memset(bound, 0xFF, sizeof(bound));
+        range.appendBinData("$lte", sizeof(bound), mongo::bdtUUID, bound);
+    }
+
+    mongo::BSONObjBuilder query;
+    query.append(MongoClientWrapper::ID, range.obj());
+    return query.obj();
+}
+
+mongo::BSONObj repo::core::MongoClientPool::nonUUIDQuery()
+{
+    mongo::BSONObj uuids = uuidRangeQuery(0, 256);
+
+    mongo::BSONObjBuilder query;
+    query.append(
+                MongoClientWrapper::ID,
+                BSON("$not" << uuids.getObjectField(MongoClientWrapper::ID)));
+    return query.obj();
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::MongoClientPool::log(const std::string &message)
+{
+    RepoLogger::instance().log(message, RepoSeverity::REPO_DEBUG);
+}
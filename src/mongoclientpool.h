@@ -0,0 +1,208 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MONGOCLIENTPOOL_H
+#define MONGOCLIENTPOOL_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+//------------------------------------------------------------------------------
+#include <mongo/client/dbclient.h> // mongo c++ driver
+#include <mongo/bson/bson.h>
+//------------------------------------------------------------------------------
+#include "mongoclientwrapper.h"
+
+#include "repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//! Fixed size pool of authenticated MongoDB connections.
+/*!
+ * Each connection is a copy of the prototype wrapper passed to the constructor
+ * and is reconnected and reauthenticated using the credentials stored in it,
+ * hence the prototype has to be authenticated on all databases the pool
+ * is going to be used with. A single connection carries a single traffic
+ * stream, so each thread has to acquire its own connection and release it
+ * once done.
+ */
+class REPO_CORE_EXPORT MongoClientPool
+{
+
+public:
+
+    //! Scoped connection which is returned to the pool on destruction.
+    class REPO_CORE_EXPORT ScopedConnection
+    {
+
+    public:
+
+        //! Blocks until a connection is available in the pool.
+        ScopedConnection(MongoClientPool &pool)
+            : pool(pool)
+            , connection(pool.acquire()) {}
+
+        //! Releases the connection back to the pool unless discarded.
+        ~ScopedConnection() { pool.release(connection); }
+
+        /*! Replaces the connection in the pool by a new one, eg when an
+         * exhaust cursor failed midway and unread replies may still arrive
+         * on it. The connection must not be used afterwards.
+         */
+        void discard() { pool.discard(connection); connection = NULL; }
+
+        MongoClientWrapper *operator->() { return connection; }
+
+        MongoClientWrapper &operator*() { return *connection; }
+
+        //! Returns the connection, NULL if the pool is empty.
+        MongoClientWrapper *get() { return connection; }
+
+    private:
+
+        ScopedConnection(const ScopedConnection &);
+
+        ScopedConnection &operator=(const ScopedConnection &);
+
+        MongoClientPool &pool;
+
+        MongoClientWrapper *connection;
+
+    }; // end ScopedConnection
+
+public:
+
+    //--------------------------------------------------------------------------
+    //! Default number of connections, one per hardware thread.
+    static unsigned int getDefaultSize();
+
+    /*! Creates a pool of given size by duplicating the prototype wrapper and
+     * reconnecting and reauthenticating each of the copies. Connections that
+     * fail to connect are not added to the pool.
+     */
+    MongoClientPool(
+            const MongoClientWrapper &prototype,
+            unsigned int size = getDefaultSize());
+
+    //! Deallocates all connections. All of them have to be released by now.
+    ~MongoClientPool();
+
+    //--------------------------------------------------------------------------
+    //
+    // Connections
+    //
+    //--------------------------------------------------------------------------
+
+    /*! Returns a connection from the pool, blocks until one becomes available.
+     * Returns NULL if the pool is empty (no connection could be established).
+     */
+    MongoClientWrapper *acquire();
+
+    //! Returns the connection back to the pool.
+    void release(MongoClientWrapper *connection);
+
+    /*! Deallocates an acquired connection whose traffic stream is no longer
+     * usable and adds a freshly connected copy of the prototype in its
+     * place. If reconnection fails, the pool shrinks by one.
+     */
+    void discard(MongoClientWrapper *connection);
+
+    //! Returns the number of connections this pool manages.
+    unsigned int size() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return (unsigned int) connections.size();
+    }
+
+    //! Returns the number of connections requested on construction.
+    unsigned int getRequestedSize() const { return requestedSize; }
+
+    //--------------------------------------------------------------------------
+    //
+    // Queries
+    //
+    //--------------------------------------------------------------------------
+
+    /*! Populates the ret vector with all BSON objs found in the collection
+     * by splitting the UUID _id space into equal ranges and fetching each
+     * range on a separate connection and thread. Documents whose _id is not
+     * a bdtUUID, which should not be the case in scene and history
+     * collections, are fetched by one more query. Returns true if at least
+     * one BSON obj loaded, false otherwise, including when any of the ranges
+     * could not be counted or fetched entirely, in which case ret is left
+     * as it was.
+     */
+    bool fetchEntireCollection(
+            const std::string &database,
+            const std::string &collection,
+            std::vector<mongo::BSONObj> &ret);
+
+    //--------------------------------------------------------------------------
+    //
+    // Static helpers
+    //
+    //--------------------------------------------------------------------------
+
+    /*! Returns a query matching a range of UUID _id values whose first byte
+     * lies in the interval [first, last). If last is 256, the range ends
+     * with the largest UUID inclusive.
+     */
+    static mongo::BSONObj uuidRangeQuery(unsigned int first, unsigned int last);
+
+    /*! Returns a query matching all _id values that are not matched by
+     * uuidRangeQuery(0, 256), ie anything but a bdtUUID.
+     */
+    static mongo::BSONObj nonUUIDQuery();
+
+private:
+
+    MongoClientPool(const MongoClientPool &);
+
+    MongoClientPool &operator=(const MongoClientPool &);
+
+    //! Logs messages using the repo logger.
+    void log(const std::string &message);
+
+private:
+
+    //! Disconnected copy of the prototype to create replacements from.
+    const MongoClientWrapper prototype;
+
+    //! Number of connections requested on construction.
+    const unsigned int requestedSize;
+
+    //! All connections owned by this pool.
+    std::vector<MongoClientWrapper *> connections;
+
+    //! Connections which are currently not in use.
+    std::vector<MongoClientWrapper *> available;
+
+    //! Guards the connections.
+    mutable std::mutex mutex;
+
+    //! Signalled whenever a connection is released.
+    std::condition_variable connectionReleased;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // MONGOCLIENTPOOL_H
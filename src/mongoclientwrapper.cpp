@@ -1,6 +1,8 @@
 //------------------------------------------------------------------------------
 
 #include "mongoclientwrapper.h"
+#include "mongoclientpool.h"
+#include "mongobatchwriter.h"
 #include "conversion/repo_transcoder_string.h"
 #include "repologger.h"
 #include "primitives/reposeverity.h"
@@ -47,6 +49,7 @@ repo::core::MongoClientWrapper::MongoClientWrapper(
     repo::core::MongoClientWrapper&& other)
     : hostAndPort(other.hostAndPort)
 	, databasesAuthentication(other.databasesAuthentication)
+    , connectionPool(std::move(other.connectionPool))
 {
 	other.hostAndPort = mongo::HostAndPort();
 	other.databasesAuthentication.clear();
@@ -59,6 +62,7 @@ repo::core::MongoClientWrapper& repo::core::MongoClientWrapper::operator= (
 {
 	hostAndPort = other.hostAndPort;
 	databasesAuthentication = other.databasesAuthentication;
+    connectionPool.reset();
 	return *this;
 }
 
@@ -73,6 +77,8 @@ repo::core::MongoClientWrapper& repo::core::MongoClientWrapper::operator=(
 	databasesAuthentication = other.databasesAuthentication;
 	other.databasesAuthentication.clear();
 
+    connectionPool = std::move(other.connectionPool);
+
 	return *this;
 }
 
@@ -194,6 +200,7 @@ bool repo::core::MongoClientWrapper::connect(const std::string &host, int port)
 {
 	// -1 uses default port
 	hostAndPort = mongo::HostAndPort(host, port >= 0 ? port : -1);
+    connectionPool.reset();
 	return connect(hostAndPort);
 }
 
@@ -238,8 +245,13 @@ bool repo::core::MongoClientWrapper::authenticate(
         {
             //----------------------------------------------------------------------
             // Preserve authentication details for connection duplication
-            databasesAuthentication[database] =
+            std::pair<std::string, std::string> credentials =
                 std::make_pair(username, passwordDigest);
+            if (databasesAuthentication[database] != credentials)
+            {
+                databasesAuthentication[database] = credentials;
+                connectionPool.reset();
+            }
         }
         else
             log(errmsg);
@@ -536,7 +548,6 @@ std::auto_ptr<mongo::DBClientCursor> repo::core::MongoClientWrapper::listAll(
 			getNamespace(database, collection), 
 			mongo::BSONObj(), 
 			mongo::QueryOption_Exhaust);	
-		checkForError();
 	}
 	catch (mongo::DBException& e)
 	{
@@ -565,7 +576,6 @@ std::auto_ptr<mongo::DBClientCursor> repo::core::MongoClientWrapper::listAllTail
                     mongo::Query(),
                     0,
                     skip);
-		checkForError();					
 	}
 	catch (mongo::DBException& e)
 	{
@@ -593,7 +603,6 @@ std::auto_ptr<mongo::DBClientCursor> repo::core::MongoClientWrapper::listAllTail
 			0, 
 			skip, 
             &obj);
-		checkForError();					
 	}
 	catch (mongo::DBException& e)
 	{
@@ -620,7 +629,6 @@ std::auto_ptr<mongo::DBClientCursor> repo::core::MongoClientWrapper::findAllByUn
 			query.obj(), 
 			0, 
 			skip);
-		checkForError();					
 	}
 	catch (mongo::DBException& e)
 	{
@@ -714,6 +722,116 @@ mongo::BSONObj repo::core::MongoClientWrapper::runCommand(
     return info;
 }
 
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientWrapper::aggregate(
+        const std::string &database,
+        const std::string &collection,
+        const mongo::BSONArray &pipeline,
+        const std::function<void(const mongo::BSONObj &)> &consumer,
+        bool allowDiskUse)
+{
+    bool success = false;
+    try
+    {
+        mongo::BSONObjBuilder builder;
+        builder.append("aggregate", collection);
+        builder.appendArray("pipeline", pipeline);
+        builder.append("cursor", mongo::BSONObj());
+        builder.append("allowDiskUse", allowDiskUse);
+
+        log("db." + collection + ".aggregate(" + pipeline.toString(true) + ");");
+        mongo::BSONObj info;
+        success = clientConnection.runCommand(database, builder.obj(), info);
+        if (!success)
+            log(info.toString());
+        else
+        {
+            //------------------------------------------------------------------
+            // First batch is part of the command reply, the rest is retrieved
+            // by getMore on the returned cursor id.
+            mongo::BSONObj cursorInfo = info.getObjectField("cursor");
+            mongo::BSONObjIterator it(cursorInfo.getObjectField("firstBatch"));
+            while (it.more())
+                consumer(it.next().embeddedObject());
+
+            long long cursorId = cursorInfo.getField("id").numberLong();
+            if (cursorId != 0)
+            {
+                mongo::DBClientCursor cursor(
+                            &clientConnection,
+                            cursorInfo.getStringField("ns"),
+                            cursorId,
+                            0,
+                            0);
+                while (cursor.more())
+                    consumer(cursor.next());
+            }
+        }
+    }
+    catch (mongo::DBException &e)
+    {
+        log(std::string(e.what()));
+        success = false;
+    }
+    return success;
+}
+
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientWrapper::fetchEntireCollection(
+    const std::string &database,
+    const std::string &collection,
+    const std::function<void(const mongo::BSONObj &)> &consumer,
+    int batchSize,
+    const std::list<std::string> &fields,
+    unsigned long long *retrieved)
+{
+    return fetchEntireCollection(
+        database,
+        collection,
+        consumer,
+        fields.empty() ? mongo::BSONObj() : fieldsToReturn(fields),
+        batchSize,
+        retrieved);
+}
+
+bool repo::core::MongoClientWrapper::fetchEntireCollection(
+    const std::string &database,
+    const std::string &collection,
+    const std::function<void(const mongo::BSONObj &)> &consumer,
+    const mongo::BSONObj &projection,
+    int batchSize,
+    unsigned long long *retrieved)
+{
+    bool success = true;
+    unsigned long long count = 0;
+    try
+    {
+        log("db." + collection + ".find();");
+        std::auto_ptr<mongo::DBClientCursor> cursor = clientConnection.query(
+            getNamespace(database, collection),
+            mongo::Query(),
+            0,
+            0,
+            projection.isEmpty() ? NULL : &projection,
+            mongo::QueryOption_Exhaust,
+            batchSize);
+        while (cursor.get() && cursor->more())
+        {
+            consumer(cursor->next());
+            ++count;
+        }
+    }
+    catch (mongo::DBException& e)
+    {
+        log(std::string(e.what()));
+        success = false;
+    }
+    if (retrieved)
+        *retrieved = count;
+    return success;
+}
 
 //------------------------------------------------------------------------------
 
@@ -722,23 +840,41 @@ bool repo::core::MongoClientWrapper::fetchEntireCollection(
 	const std::string &collection,
 	std::vector<mongo::BSONObj> &ret)
 {		
-	// TODO: fix this to make sure infinite loops cannot occur if someone deletes something from db in the meantime.
-	unsigned long long retrieved = 0;
-	unsigned long long count = countItemsInCollection(database, collection);	
-	while (count > retrieved)
-	{
-		std::auto_ptr<mongo::DBClientCursor> cursor = listAllTailable(database, collection, retrieved);
-		if (cursor.get())
-		{
-			int i = 0;
-			for (; cursor->more(); ++i)
-				ret.push_back(cursor->next().copy());
-			retrieved += i;
-		}
-		// works for now
-		//count = mongo->countItemsInCollection(dbName, collectionName);
-	}
-	return retrieved > 0;	
+    const size_t start = ret.size();
+    if (!fetchEntireCollection(
+        database,
+        collection,
+        [&ret](const mongo::BSONObj &obj) { ret.push_back(obj.getOwned()); }))
+    {
+        ret.resize(start);
+        return false;
+    }
+    return ret.size() > start;
+}
+
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientWrapper::fetchEntireCollectionParallel(
+    const std::string &database,
+    const std::string &collection,
+    std::vector<mongo::BSONObj> &ret,
+    unsigned int threads)
+{
+    return getConnectionPool(threads).fetchEntireCollection(
+        database, collection, ret);
+}
+
+//------------------------------------------------------------------------------
+
+repo::core::MongoClientPool &repo::core::MongoClientWrapper::getConnectionPool(
+    unsigned int size)
+{
+    if (0 == size)
+        size = MongoClientPool::getDefaultSize();
+    if (!connectionPool || connectionPool->size() == 0 ||
+        connectionPool->getRequestedSize() != size)
+        connectionPool.reset(new MongoClientPool(*this, size));
+    return *connectionPool;
 }
 
 //------------------------------------------------------------------------------
@@ -779,24 +915,11 @@ void repo::core::MongoClientWrapper::getRevision(
 //------------------------------------------------------------------------------
 
 bool repo::core::MongoClientWrapper::fetchRevision(
-    std::vector<mongo::BSONObj> &ret,
-    std::string dbName,
-    std::string collection,
-    const std::set<int64_t> &revisionNumbersAncestralArray)
+    const std::string &dbName,
+    const std::string &collection,
+    const std::set<int64_t> &revisionNumbersAncestralArray,
+    const std::function<void(const mongo::BSONObj &)> &consumer)
 {
-
-	/////////////////////////////////////////////////////////////////////
-	// Get all UUIDS
-	/////////////////////////////////////////////////////////////////////
-	std::string msg;
-	msg+= "function() {";
-		msg += "return db." + collection + ".distinct('uuid');";
-	msg += "}";
-	mongo::BSONObj info;
-	mongo::BSONElement retVal;
-	clientConnection.eval(dbName, msg, info, retVal);
-	std::vector<mongo::BSONElement> uuids = retVal.Array();	
-		
 	/////////////////////////////////////////////////////////////////////
 	// Build array of all possible revisions where to look for the nodes
 	/////////////////////////////////////////////////////////////////////
@@ -807,36 +930,37 @@ bool repo::core::MongoClientWrapper::fetchRevision(
 	mongo::BSONArray ancestralArray = arrayBuilder.arr();
 
 	/////////////////////////////////////////////////////////////////////
-	// Retrieve one node at a time
+	// Newest revision of each uuid is resolved on the server:
+	// $match ancestral revisions, $sort newest first, $group by uuid
 	/////////////////////////////////////////////////////////////////////
-	for (unsigned int i = 0; i < uuids.size(); i++)
-	{
-		mongo::BSONObjBuilder builder;
-        appendUUID(UUID, retrieveUUID(uuids.at(i)), builder);
-		builder.appendElements(BSON("revision"<< BSON("$in" << ancestralArray)));
-				
-		bson::bo obj = clientConnection.findOne(
-			dbName + "." + collection, 
-			mongo::Query(builder.obj()).sort("revision", -1));
-
-		//logger->log(vINFO, obj.toString());
-		ret.push_back(obj.copy());
-	}
+	mongo::BSONArrayBuilder pipeline;
+	pipeline.append(BSON("$match" << BSON("revision" << BSON("$in" << ancestralArray))));
+	pipeline.append(BSON("$sort" << BSON("revision" << -1)));
+	pipeline.append(BSON("$group" << BSON(
+		ID << "$" + UUID <<
+		"node" << BSON("$first" << "$$ROOT"))));
+
+	return aggregate(
+		dbName,
+		collection,
+		pipeline.arr(),
+		[&consumer](const mongo::BSONObj &obj)
+		{ consumer(obj.getObjectField("node")); });
+}
 
-	std::stringstream sstr;
-	sstr << "function() {";
-		sstr << "var arr=db." << collection<<".distinct('uuid');";
-		sstr << "var results= new Array();";
-		sstr << "for (var i = 0; i $lt arr.length; i++) {";
-			sstr << "var cursor = db." << collection;
-				sstr <<".find({'uuid':arr[i]";
-				sstr<<",'revision':{$in: " << ancestralArray.toString() <<"}";
-				sstr<<"}).sort({'revision':-1}).limit(1);"; 
-			sstr << "results[i] = cursor[0];";
-		sstr << "}";
-		sstr << "return results;";
-	sstr << "}";
-	return checkForError();
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientWrapper::fetchRevision(
+    std::vector<mongo::BSONObj> &ret,
+    std::string dbName,
+    std::string collection,
+    const std::set<int64_t> &revisionNumbersAncestralArray)
+{
+	return fetchRevision(
+		dbName,
+		collection,
+		revisionNumbersAncestralArray,
+		[&ret](const mongo::BSONObj &obj) { ret.push_back(obj.getOwned()); });
 }
 
 //------------------------------------------------------------------------------
@@ -928,18 +1052,33 @@ void repo::core::MongoClientWrapper::insertRecord(
 
 //------------------------------------------------------------------------------
 
-void repo::core::MongoClientWrapper::insertRecords(
+bool repo::core::MongoClientWrapper::insertRecords(
 	const std::string &database, 
 	const std::string &collection, 
 	const std::vector<mongo::BSONObj> &objs, 
 	bool inReverse)
 {
-	if (inReverse)
-		for (int i = objs.size() - 1; i >= 0; --i)
-			insertRecord(database, collection, objs[i]);	
-	else 
-		for (unsigned int i = 0; i < objs.size(); ++i)
-			insertRecord(database, collection, objs[i]);		
+    const std::string ns = getNamespace(database, collection);
+    bool success = true;
+    std::vector<mongo::BSONObj> batch;
+    int batchBytes = 0;
+    for (unsigned int i = 0; i < objs.size(); ++i)
+    {
+        const mongo::BSONObj &obj = inReverse ? objs[objs.size() - 1 - i] : objs[i];
+        if (!batch.empty() &&
+                (batch.size() >= MongoBatchWriter::MAX_BATCH_DOCUMENTS ||
+                 batchBytes + obj.objsize() > (int) MongoBatchWriter::MAX_BATCH_BYTES))
+        {
+            success = insertBatch(ns, batch) && success;
+            batch.clear();
+            batchBytes = 0;
+        }
+        batch.push_back(obj);
+        batchBytes += obj.objsize();
+    }
+    if (!batch.empty())
+        success = insertBatch(ns, batch) && success;
+    return success;
 }
 
 void repo::core::MongoClientWrapper::updateRecord(
@@ -972,6 +1111,33 @@ mongo::BSONObj repo::core::MongoClientWrapper::fieldsToReturn(
 	return fieldsToReturn.obj();
 }
 
+mongo::BSONObj repo::core::MongoClientWrapper::fieldsToExclude(
+        const std::list<std::string>& fields)
+{
+    mongo::BSONObjBuilder fieldsToExclude;
+    std::list<std::string>::const_iterator it;
+    for (it = fields.begin(); it != fields.end(); ++it)
+        fieldsToExclude << *it << 0;
+    return fieldsToExclude.obj();
+}
+
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoClientWrapper::insertBatch(
+    const std::string &ns,
+    const std::vector<mongo::BSONObj> &batch)
+{
+    try
+    {
+        clientConnection.insert(ns, batch, mongo::InsertOption_ContinueOnError);
+    }
+    catch (mongo::DBException& e)
+    {
+        log(std::string(e.what()));
+    }
+    return checkLastError();
+}
+
 //------------------------------------------------------------------------------
 
 bool repo::core::MongoClientWrapper::checkForError()
@@ -982,3 +1148,21 @@ bool repo::core::MongoClientWrapper::checkForError()
 //        log(err);
     return true;
 }
+
+bool repo::core::MongoClientWrapper::checkLastError()
+{
+    bool ok = true;
+    try
+    {
+        std::string err = clientConnection.getLastError();
+        ok = err.empty();
+        if (!ok)
+            log(err);
+    }
+    catch (mongo::DBException& e)
+    {
+        log(std::string(e.what()));
+        ok = false;
+    }
+    return ok;
+}
@@ -22,6 +22,8 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <functional>
+#include <memory>
 //------------------------------------------------------------------------------
 #include <mongo/client/dbclient.h> // mongo c++ driver
 #include <mongo/bson/bson.h>
@@ -37,6 +39,8 @@
 namespace repo {
 namespace core {
 
+class MongoClientPool;
+
 class REPO_CORE_EXPORT MongoClientWrapper
 {
 
@@ -313,17 +317,89 @@ public:
             const std::string &database,
             const mongo::BSONObj &command);
 
-    //--------------------------------------------------------------------------
-	// Deprecated
-	//
+    /*! Runs an aggregation pipeline on the collection and streams the
+     * resulting documents to the consumer through a server side cursor, hence
+     * the result is not limited to a single 16MB document. Objects passed to
+     * the consumer are only valid for the duration of the call. Returns false
+     * if the aggregation failed.
+     * See http://docs.mongodb.org/manual/reference/command/aggregate/
+     */
+    bool aggregate(
+            const std::string &database,
+            const std::string &collection,
+            const mongo::BSONArray &pipeline,
+            const std::function<void(const mongo::BSONObj &)> &consumer,
+            bool allowDiskUse = true);
+
+    /*! Streams all BSON objs found in the collection to the consumer using a
+     * single exhaust cursor. Objects passed to the consumer are only valid for
+     * the duration of the call, use getOwned() to keep them. Only the given
+     * fields are returned if the list is not empty. The number of objects
+     * passed to the consumer is stored in retrieved if given. Returns false
+     * if the query failed, possibly after some objects have been consumed,
+     * in which case unread exhaust replies may still arrive and the
+     * connection must not be used any further.
+     */
+    bool fetchEntireCollection(
+        const std::string &database,
+        const std::string &collection,
+        const std::function<void(const mongo::BSONObj &)> &consumer,
+        int batchSize = 0,
+        const std::list<std::string> &fields = std::list<std::string>(),
+        unsigned long long *retrieved = NULL);
+
+    /*! Streams all BSON objs found in the collection to the consumer using a
+     * single exhaust cursor, applying the given projection, eg one built by
+     * fieldsToReturn() or fieldsToExclude(). Returns false if the query
+     * failed, see above.
+     */
+    bool fetchEntireCollection(
+        const std::string &database,
+        const std::string &collection,
+        const std::function<void(const mongo::BSONObj &)> &consumer,
+        const mongo::BSONObj &projection,
+        int batchSize = 0,
+        unsigned long long *retrieved = NULL);
+
 	/*! Populates the ret vector with all BSON objs found in the collection
-		Returns true if at least one BSON obj loaded, false otherwise
+		Returns true if at least one BSON obj loaded, false otherwise or if
+		the query failed midway, in which case ret is left as it was
 	*/
 	bool fetchEntireCollection(
 		const std::string& /* database */, 
 		const std::string& /* collection */,
 		std::vector<mongo::BSONObj>& /* ret */);
 
+    /*! Returns the pool of duplicated connections of this wrapper. The pool
+     * is created on first use and kept for subsequent calls, it is recreated
+     * only if a different size is requested or the credentials changed.
+     * If size is 0, one connection per hardware thread is used.
+     */
+    MongoClientPool &getConnectionPool(unsigned int size = 0);
+
+    /*! Populates the ret vector with all BSON objs found in the collection
+     * using the pool of duplicated connections, each fetching a range of the
+     * UUID _id space on a separate thread. If threads is 0, one connection
+     * per hardware thread is used. Returns true if at least one BSON obj
+     * loaded, false otherwise or if any of the ranges failed, see
+     * MongoClientPool::fetchEntireCollection().
+     */
+    bool fetchEntireCollectionParallel(
+        const std::string &database,
+        const std::string &collection,
+        std::vector<mongo::BSONObj> &ret,
+        unsigned int threads = 0);
+
+
+    /*! Streams the newest version of each node (by uuid) that belongs to one
+     * of the revisions listed in the ancestral set. The head revision is
+     * resolved on the server by a single aggregation pipeline. Returns false
+     * if error.
+     */
+    bool fetchRevision(const std::string &dbName,
+                       const std::string &collection,
+                       const std::set<int64_t> &revisionNumbersAncestralArray,
+                       const std::function<void(const mongo::BSONObj &)> &consumer);
 
     //--------------------------------------------------------------------------
 	// DEPRECATED
@@ -373,7 +449,12 @@ public:
 		const std::string &collection, 
 		const mongo::BSONObj &obj);
 
-	void insertRecords(
+    /*! Inserts all objects using as few insert messages as possible. Objects
+     * are grouped into batches of up to 1000 documents and 16MB which are sent
+     * as unordered inserts that continue on error. Returns true if no batch
+     * reported an error, false otherwise.
+     */
+	bool insertRecords(
 		const std::string &database, 
 		const std::string &collection, 
 		const std::vector<mongo::BSONObj> &objs, 
@@ -424,6 +505,11 @@ public:
             const std::list<std::string>& list,
             bool excludeIdField = false);
 
+    /*! Generates a BSONObj with given strings labelled as excluded from
+     * the query, ie { string1 : 0, string2: 0 ... }
+     */
+    static mongo::BSONObj fieldsToExclude(const std::list<std::string>& list);
+
 
 
     mongo::DBClientConnection clientConnection;
@@ -435,6 +521,18 @@ private :
      */
 	bool checkForError();
 
+    /*! Asks the server for the last error and logs it if any. Returns true if
+     * no error, false otherwise. Requires a round trip, hence only used once
+     * per batch, never while an exhaust cursor is being read on this
+     * connection.
+     */
+    bool checkLastError();
+
+    //! Sends a single insert message continuing on error and checks for error.
+    bool insertBatch(
+            const std::string &ns,
+            const std::vector<mongo::BSONObj> &batch);
+
 private :
 
     //---------------------------------------------------------------------------
@@ -445,7 +543,7 @@ private :
 
     /*! Client connection to the server. There can only be one traffic stream
      *  for one connection.	To perform parallel fetching, duplicate this wrapper
-     * object.
+     * object or use MongoClientPool.
      */
 //	mongo::DBClientConnection clientConnection;
 
@@ -458,6 +556,9 @@ private :
      * connection.
      */
 	std::map<std::string, std::pair<std::string, std::string> > databasesAuthentication;
+
+    //! Connections duplicated from this one, see getConnectionPool().
+    std::shared_ptr<MongoClientPool> connectionPool;
 };
 
 } // end of core namespace
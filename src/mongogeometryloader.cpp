@@ -0,0 +1,189 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongogeometryloader.h"
+#include "conversion/repo_transcoder_bson.h"
+#include "conversion/repo_transcoder_string.h"
+#include "repologger.h"
+#include "primitives/reposeverity.h"
+
+//------------------------------------------------------------------------------
+const unsigned int repo::core::MongoGeometryLoader::DEFAULT_BATCH_SIZE = 100;
+//------------------------------------------------------------------------------
+
+repo::core::MongoGeometryLoader::MongoGeometryLoader(
+        const MongoClientWrapper &prototype,
+        const std::string &database,
+        const std::string &collection,
+        unsigned int batchSize)
+    : connection(prototype)
+    , database(database)
+    , collection(collection)
+    , batchSize(batchSize > 0 ? batchSize : 1)
+    , stopping(false)
+{
+    if (!connection.reconnectAndReauthenticate())
+        log("Geometry loader connection to " + prototype.getHostAndPort() +
+            " failed.");
+}
+
+repo::core::MongoGeometryLoader::~MongoGeometryLoader()
+{
+    stopping = true;
+    if (background.joinable())
+        background.join();
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::MongoGeometryLoader::addMesh(RepoNodeMesh *mesh)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (mesh && !mesh->isGeometryLoaded())
+    {
+        pending[mesh->getUniqueID()] = mesh;
+        mesh->setGeometryLoader(this);
+    }
+}
+
+void repo::core::MongoGeometryLoader::removeMesh(RepoNodeMesh *mesh)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (mesh)
+        pending.erase(mesh->getUniqueID());
+}
+
+bool repo::core::MongoGeometryLoader::load(RepoNodeMesh *mesh)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    // Might have been loaded by another thread while waiting for the lock
+    if (mesh->isGeometryLoaded())
+        return true;
+    if (pending.find(mesh->getUniqueID()) == pending.end())
+        return false;
+
+    std::vector<RepoNodeMesh *> batch;
+    batch.push_back(mesh);
+    std::map<boost::uuids::uuid, RepoNodeMesh *>::iterator it;
+    for (it = pending.begin(); it != pending.end() && batch.size() < batchSize; ++it)
+        if (it->second != mesh)
+            batch.push_back(it->second);
+    return fetch(batch);
+}
+
+void repo::core::MongoGeometryLoader::loadInBackground()
+{
+    if (background.joinable())
+        return;
+
+    background = std::thread([this]()
+    {
+        while (!stopping)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending.empty())
+                break;
+
+            std::vector<RepoNodeMesh *> batch;
+            std::map<boost::uuids::uuid, RepoNodeMesh *>::iterator it;
+            for (it = pending.begin(); it != pending.end() && batch.size() < batchSize; ++it)
+                batch.push_back(it->second);
+            fetch(batch);
+        }
+    });
+}
+
+bool repo::core::MongoGeometryLoader::loadAll()
+{
+    bool success = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!pending.empty())
+    {
+        std::vector<RepoNodeMesh *> batch;
+        std::map<boost::uuids::uuid, RepoNodeMesh *>::iterator it;
+        for (it = pending.begin(); it != pending.end() && batch.size() < batchSize; ++it)
+            batch.push_back(it->second);
+        success = fetch(batch) && success;
+    }
+    return success;
+}
+
+unsigned int repo::core::MongoGeometryLoader::getPendingCount()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return (unsigned int) pending.size();
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+bool repo::core::MongoGeometryLoader::fetch(
+        const std::vector<RepoNodeMesh *> &meshes)
+{
+    std::map<boost::uuids::uuid, RepoNodeMesh *> requested;
+    mongo::BSONObjBuilder ids;
+    for (unsigned int i = 0; i < meshes.size(); ++i)
+    {
+        const boost::uuids::uuid id = meshes[i]->getUniqueID();
+        requested[id] = meshes[i];
+        pending.erase(id);
+        MongoClientWrapper::appendUUID(RepoTranscoderString::toString(i), id, ids);
+    }
+
+    try
+    {
+        std::auto_ptr<mongo::DBClientCursor> cursor =
+                connection.findAllByUniqueIDs(
+                    database, collection, mongo::BSONArray(ids.obj()), 0);
+        while (cursor.get() && cursor->more())
+        {
+            mongo::BSONObj obj = cursor->next();
+            std::map<boost::uuids::uuid, RepoNodeMesh *>::iterator it =
+                    requested.find(RepoTranscoderBSON::retrieve(
+                                       obj.getField(MongoClientWrapper::ID)));
+            if (requested.end() != it)
+            {
+                it->second->setGeometry(obj);
+                requested.erase(it);
+            }
+        }
+    }
+    catch (mongo::DBException& e)
+    {
+        log(std::string(e.what()));
+    }
+
+    //--------------------------------------------------------------------------
+    // Detach meshes that could not be fetched so that they are not retried
+    // on every access.
+    std::map<boost::uuids::uuid, RepoNodeMesh *>::iterator it;
+    for (it = requested.begin(); it != requested.end(); ++it)
+    {
+        log("Geometry of mesh " + RepoTranscoderString::toString(it->first) +
+            " could not be loaded.");
+        it->second->setGeometryLoader(NULL);
+    }
+    return requested.empty();
+}
+
+void repo::core::MongoGeometryLoader::log(const std::string &message)
+{
+    RepoLogger::instance().log(message, RepoSeverity::REPO_DEBUG);
+}
@@ -0,0 +1,138 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MONGOGEOMETRYLOADER_H
+#define MONGOGEOMETRYLOADER_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+//------------------------------------------------------------------------------
+#include <boost/uuid/uuid.hpp>
+//------------------------------------------------------------------------------
+#include "mongoclientwrapper.h"
+#include "graph/repo_geometry_loader.h"
+#include "graph/repo_node_mesh.h"
+
+#include "repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//! Geometry loader fetching mesh geometry from a MongoDB collection.
+/*!
+ * Meshes retrieved as a skeleton, ie using
+ * MongoClientWrapper::fieldsToExclude(RepoNodeMesh::getGeometryFields()), are
+ * registered with this loader. Once geometry of any of them is accessed, it
+ * is fetched together with geometry of up to batchSize - 1 other pending
+ * meshes in a single findAllByUniqueIDs query. Alternatively, all pending
+ * meshes can be populated in batches by a background thread. The loader uses
+ * its own copy of the connection so that it does not interfere with cursors
+ * open on the original one.
+ */
+class REPO_CORE_EXPORT MongoGeometryLoader : public RepoGeometryLoader
+{
+
+public:
+
+    //! Default number of meshes fetched by a single query.
+    static const unsigned int DEFAULT_BATCH_SIZE;
+
+public:
+
+    /*! Duplicates and reauthenticates the prototype connection, which has to
+     * be authenticated on the given database.
+     */
+    MongoGeometryLoader(
+            const MongoClientWrapper &prototype,
+            const std::string &database,
+            const std::string &collection,
+            unsigned int batchSize = DEFAULT_BATCH_SIZE);
+
+    //! Stops the background loading, if any, and joins its thread.
+    ~MongoGeometryLoader();
+
+    //--------------------------------------------------------------------------
+    //
+    // Loading
+    //
+    //--------------------------------------------------------------------------
+
+    //! Registers a mesh retrieved without geometry and sets itself as its loader.
+    void addMesh(RepoNodeMesh *mesh);
+
+    //! Unregisters a mesh so that its geometry is not fetched any more.
+    void removeMesh(RepoNodeMesh *mesh);
+
+    //! Fetches geometry of the mesh along with a batch of other pending meshes.
+    bool load(RepoNodeMesh *mesh);
+
+    /*! Fetches geometry of all pending meshes in batches on a background
+     * thread. Meshes accessed in the meantime are loaded on demand as usual.
+     */
+    void loadInBackground();
+
+    //! Fetches geometry of all pending meshes. Returns true if all succeeded.
+    bool loadAll();
+
+    //! Returns the number of meshes whose geometry has not been fetched yet.
+    unsigned int getPendingCount();
+
+private:
+
+    MongoGeometryLoader(const MongoGeometryLoader &);
+
+    MongoGeometryLoader &operator=(const MongoGeometryLoader &);
+
+    /*! Fetches geometry of given meshes in a single query. The mutex has to be
+     * locked by the caller. Returns true if all meshes have been populated.
+     */
+    bool fetch(const std::vector<RepoNodeMesh *> &meshes);
+
+    //! Logs messages using the repo logger.
+    void log(const std::string &message);
+
+private:
+
+    //! Dedicated connection, guarded by the mutex.
+    MongoClientWrapper connection;
+
+    std::string database;
+
+    std::string collection;
+
+    unsigned int batchSize;
+
+    //! Meshes still without geometry indexed by their unique ID.
+    std::map<boost::uuids::uuid, RepoNodeMesh *> pending;
+
+    std::mutex mutex;
+
+    std::thread background;
+
+    std::atomic<bool> stopping;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // MONGOGEOMETRYLOADER_H
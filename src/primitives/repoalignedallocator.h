@@ -0,0 +1,121 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_ALIGNED_ALLOCATOR_H
+#define REPO_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+//------------------------------------------------------------------------------
+#if defined(_WIN32) || defined(_WIN64)
+#   include <malloc.h>
+#endif
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//------------------------------------------------------------------------------
+/*!
+ * Standard library allocator returning memory aligned to Alignment bytes, eg
+ * 32 for AVX or 64 for a cache line, so that std::vector<T,
+ * RepoAlignedAllocator<T> > can be processed with aligned SIMD loads.
+ * Alignment has to be a power of two and a multiple of sizeof(void *).
+ */
+template <class T, std::size_t Alignment = 64>
+class RepoAlignedAllocator
+{
+
+public:
+
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind { typedef RepoAlignedAllocator<U, Alignment> other; };
+
+    static const std::size_t ALIGNMENT = Alignment;
+
+public:
+
+    RepoAlignedAllocator() {}
+
+    template <class U>
+    RepoAlignedAllocator(const RepoAlignedAllocator<U, Alignment> &) {}
+
+    //--------------------------------------------------------------------------
+
+    //! Allocates uninitialized storage for n elements, throws std::bad_alloc.
+    T *allocate(std::size_t n)
+    {
+        void *ptr = NULL;
+        if (n > 0)
+        {
+#if defined(_WIN32) || defined(_WIN64)
+            ptr = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+            if (0 != posix_memalign(&ptr, Alignment, n * sizeof(T)))
+                ptr = NULL;
+#endif
+            if (!ptr)
+                throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void deallocate(T *ptr, std::size_t)
+    {
+#if defined(_WIN32) || defined(_WIN64)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+    template <class U, class... Args>
+    void construct(U *ptr, Args&&... args)
+    { ::new ((void *) ptr) U(std::forward<Args>(args)...); }
+
+    template <class U>
+    void destroy(U *ptr) { ptr->~U(); }
+
+    std::size_t max_size() const { return std::size_t(-1) / sizeof(T); }
+
+    //--------------------------------------------------------------------------
+
+    template <class U>
+    bool operator==(const RepoAlignedAllocator<U, Alignment> &) const
+    { return true; }
+
+    template <class U>
+    bool operator!=(const RepoAlignedAllocator<U, Alignment> &) const
+    { return false; }
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_ALIGNED_ALLOCATOR_H
@@ -0,0 +1,271 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_BINARY_VIEW_H
+#define REPO_BINARY_VIEW_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+//------------------------------------------------------------------------------
+#include <mongo/client/dbclient.h> // the MongoDB driver
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//------------------------------------------------------------------------------
+/*!
+ * Read-only array of T borrowed from a BinDataGeneral field of a BSON object.
+ * The view shares ownership of the reference counted BSON buffer so that it
+ * stays valid for as long as any copy of the view exists, even if the object
+ * it was created from has gone.
+ *
+ * BSON does not align binary data: a blob starts right after the name of its
+ * field and the 5 byte length and subtype header, so its address depends on
+ * the lengths of the field name and all preceding fields. Hence the view
+ * never hands out references or pointers to T, elements are read by value
+ * with memcpy, which compiles to plain loads, so that the data can always
+ * be borrowed without a copy. T has to be trivially copyable. Callers that
+ * need a real T array have to ask for a copy, see toVector() and copyTo().
+ *
+ * A view can also borrow from a vector without owning it, in which case it
+ * is only valid for as long as the vector is, or adopt an array allocated
+ * with new[], eg by Assimp, which is deleted together with the last copy.
+ */
+template <class T>
+class RepoBinaryView
+{
+
+    template <class U>
+    friend class RepoBinaryView;
+
+public:
+
+    //! Random access iterator reading the elements by value.
+    class const_iterator
+    {
+
+    public:
+
+        typedef std::random_access_iterator_tag iterator_category;
+
+        typedef T value_type;
+
+        typedef std::ptrdiff_t difference_type;
+
+        typedef const T *pointer;
+
+        typedef T reference;
+
+    public:
+
+        const_iterator() : ptr(NULL) {}
+
+        explicit const_iterator(const char *ptr) : ptr(ptr) {}
+
+        T operator*() const { return load(ptr); }
+
+        T operator[](std::ptrdiff_t i) const { return load(ptr + i * sizeof(T)); }
+
+        const_iterator &operator++() { ptr += sizeof(T); return *this; }
+
+        const_iterator &operator--() { ptr -= sizeof(T); return *this; }
+
+        const_iterator operator++(int)
+        { const_iterator it(*this); ptr += sizeof(T); return it; }
+
+        const_iterator operator--(int)
+        { const_iterator it(*this); ptr -= sizeof(T); return it; }
+
+        const_iterator &operator+=(std::ptrdiff_t n)
+        { ptr += n * (std::ptrdiff_t) sizeof(T); return *this; }
+
+        const_iterator &operator-=(std::ptrdiff_t n)
+        { ptr -= n * (std::ptrdiff_t) sizeof(T); return *this; }
+
+        const_iterator operator+(std::ptrdiff_t n) const
+        { return const_iterator(ptr + n * (std::ptrdiff_t) sizeof(T)); }
+
+        const_iterator operator-(std::ptrdiff_t n) const
+        { return const_iterator(ptr - n * (std::ptrdiff_t) sizeof(T)); }
+
+        std::ptrdiff_t operator-(const const_iterator &other) const
+        { return (ptr - other.ptr) / (std::ptrdiff_t) sizeof(T); }
+
+        bool operator==(const const_iterator &other) const { return ptr == other.ptr; }
+
+        bool operator!=(const const_iterator &other) const { return ptr != other.ptr; }
+
+        bool operator<(const const_iterator &other) const { return ptr < other.ptr; }
+
+        bool operator>(const const_iterator &other) const { return ptr > other.ptr; }
+
+        bool operator<=(const const_iterator &other) const { return ptr <= other.ptr; }
+
+        bool operator>=(const const_iterator &other) const { return ptr >= other.ptr; }
+
+    private:
+
+        const char *ptr;
+
+    }; // end const_iterator
+
+public:
+
+    //! Empty view.
+    RepoBinaryView() : ptr(NULL), count(0) {}
+
+    //! Non-owning view of a vector, invalidated when the vector changes.
+    RepoBinaryView(const std::vector<T> *vec)
+        : ptr(vec && !vec->empty()
+              ? reinterpret_cast<const char *>(&(vec->at(0))) : NULL)
+        , count(vec ? vec->size() : 0) {}
+
+    //! View taking ownership of an array of count elements allocated by new[].
+    RepoBinaryView(T *array, size_t count)
+        : ptr(reinterpret_cast<const char *>(array))
+        , count(array ? count : 0)
+        , holder(array, std::default_delete<T[]>()) {}
+
+    /*!
+     * View of up to count elements of the binary field of the object. If the
+     * object is not owned, it is copied first as its buffer might not outlive
+     * the view. The view is empty if the field is not a BinDataGeneral blob.
+     */
+    RepoBinaryView(
+            const mongo::BSONObj &obj,
+            const std::string &field,
+            size_t count)
+        : ptr(NULL)
+        , count(0)
+    {
+        owner = obj.getOwned();
+        mongo::BSONElement bse = owner.getField(field);
+        if (bse.type() == mongo::BinData &&
+                bse.binDataType() == mongo::BinDataGeneral)
+        {
+            int length = 0;
+            ptr = bse.binData(length);
+            this->count = std::min(count, (size_t) std::max(length, 0) / sizeof(T));
+        }
+        if (!ptr || 0 == this->count)
+        {
+            ptr = NULL;
+            this->count = 0;
+            owner = mongo::BSONObj();
+        }
+    }
+
+    //--------------------------------------------------------------------------
+
+    //! Returns the raw bytes of the first element, NULL if empty. Not aligned.
+    const char *bytes() const { return ptr; }
+
+    //! Returns the number of elements.
+    size_t size() const { return count; }
+
+    //! Returns true if there are no elements.
+    bool empty() const { return 0 == count; }
+
+    //! Returns a copy of the i-th element.
+    T operator[](size_t i) const { return load(ptr + i * sizeof(T)); }
+
+    const_iterator begin() const { return const_iterator(ptr); }
+
+    const_iterator end() const { return const_iterator(ptr + count * sizeof(T)); }
+
+    //! Returns true if the data is borrowed from a BSON buffer.
+    bool isBorrowed() const { return !owner.isEmpty(); }
+
+    //! Returns a view of count elements starting at offset, sharing ownership.
+    RepoBinaryView<T> slice(size_t offset, size_t count) const
+    {
+        RepoBinaryView<T> view(*this);
+        view.ptr = offset < this->count ? ptr + offset * sizeof(T) : NULL;
+        view.count = offset < this->count ? std::min(count, this->count - offset) : 0;
+        return view;
+    }
+
+    /*!
+     * Returns a view of count elements of type U starting offset bytes into
+     * this view, sharing ownership. Returns an empty view if the elements do
+     * not fit.
+     */
+    template <class U>
+    RepoBinaryView<U> reinterpret(size_t offset, size_t count) const
+    {
+        RepoBinaryView<U> view;
+        size_t bytes = this->count * sizeof(T);
+        if (ptr && offset <= bytes && count <= (bytes - offset) / sizeof(U))
+        {
+            view.ptr = count ? ptr + offset : NULL;
+            view.count = count;
+            view.owner = owner;
+            view.holder = holder;
+        }
+        return view;
+    }
+
+    //! Copies all elements into out, which has to hold size() elements.
+    void copyTo(T *out) const
+    {
+        if (count)
+            memcpy(out, ptr, count * sizeof(T));
+    }
+
+    //! Returns a copy of the elements as a newly allocated vector.
+    std::vector<T> *toVector() const
+    {
+        std::vector<T> *vec = new std::vector<T>(count);
+        if (count)
+            copyTo(&(vec->at(0)));
+        return vec;
+    }
+
+private:
+
+    //! Reads an element from a possibly unaligned address.
+    static T load(const char *address)
+    {
+        T value;
+        memcpy(&value, address, sizeof(T));
+        return value;
+    }
+
+    const char *ptr;
+
+    size_t count;
+
+    //! Keeps the borrowed BSON buffer alive.
+    mongo::BSONObj owner;
+
+    //! Adopted array, deleted with the last copy of the view.
+    std::shared_ptr<const void> holder;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_BINARY_VIEW_H
@@ -0,0 +1,220 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repofacebuffer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+repo::core::RepoFaceBuffer::RepoFaceBuffer(
+        const aiFace *faces,
+        unsigned int count)
+    : faceSize(0)
+    , facesCount(0)
+{
+    size_t total = 0;
+    for (unsigned int i = 0; i < count; ++i)
+        total += faces[i].mNumIndices;
+    reserve(total);
+    for (unsigned int i = 0; i < count; ++i)
+        push_back(faces[i]);
+}
+
+//------------------------------------------------------------------------------
+
+void repo::core::RepoFaceBuffer::push_back(
+        const uint32_t *faceIndices,
+        unsigned int count)
+{
+    beginFace(count);
+    indices.insert(indices.end(), faceIndices, faceIndices + count);
+    endFace();
+}
+
+void repo::core::RepoFaceBuffer::clear()
+{
+    indices.clear();
+    offsets.clear();
+    faceSize = 0;
+    facesCount = 0;
+}
+
+repo::core::RepoFace repo::core::RepoFaceBuffer::at(size_t face) const
+{
+    if (face >= facesCount)
+        throw std::out_of_range("RepoFaceBuffer::at");
+    return (*this)[face];
+}
+
+unsigned int repo::core::RepoFaceBuffer::getPrimitiveTypes() const
+{
+    unsigned int types = 0;
+    if (offsets.empty())
+    {
+        if (facesCount > 0)
+            types = faceSize == 1 ? aiPrimitiveType_POINT
+                  : faceSize == 2 ? aiPrimitiveType_LINE
+                  : faceSize == 3 ? aiPrimitiveType_TRIANGLE
+                  : aiPrimitiveType_POLYGON;
+    }
+    else
+    {
+        for (size_t i = 0; i < facesCount; ++i)
+        {
+            unsigned int n = getNumIndices(i);
+            types |= n == 1 ? aiPrimitiveType_POINT
+                   : n == 2 ? aiPrimitiveType_LINE
+                   : n == 3 ? aiPrimitiveType_TRIANGLE
+                   : aiPrimitiveType_POLYGON;
+        }
+    }
+    return types;
+}
+
+//------------------------------------------------------------------------------
+//
+// Conversion
+//
+//------------------------------------------------------------------------------
+
+aiFace *repo::core::RepoFaceBuffer::toAssimp() const
+{
+    aiFace *faces = new aiFace[facesCount];
+    for (size_t i = 0; i < facesCount; ++i)
+    {
+        RepoFace face = (*this)[i];
+        faces[i].mNumIndices = face.mNumIndices;
+        faces[i].mIndices = new unsigned int[face.mNumIndices];
+        if (face.mNumIndices > 0)
+            memcpy(faces[i].mIndices, face.mIndices,
+                   face.mNumIndices * sizeof(uint32_t));
+    }
+    return faces;
+}
+
+size_t repo::core::RepoFaceBuffer::appendSerialized(
+        const char *data,
+        size_t bytes,
+        size_t count)
+{
+    size_t words = bytes / sizeof(uint32_t);
+    size_t read = 0;
+    size_t position = 0;
+
+    // Every face takes its count plus its indices
+    if (words > count)
+        indices.reserve(indices.size() + words - count);
+    while (read < count && position < words)
+    {
+        uint32_t n;
+        memcpy(&n, data + position * sizeof(uint32_t), sizeof(uint32_t));
+        if (n > words - position - 1)
+            break; // truncated
+
+        // Indices are copied straight from the possibly unaligned data
+        beginFace(n);
+        size_t start = indices.size();
+        indices.resize(start + n);
+        if (n > 0)
+            memcpy(&indices[start], data + (position + 1) * sizeof(uint32_t),
+                   n * sizeof(uint32_t));
+        endFace();
+
+        position += n + 1;
+        ++read;
+    }
+    return read;
+}
+
+void repo::core::RepoFaceBuffer::toSerialized(
+        std::vector<uint32_t> &serialized) const
+{
+    serialized.reserve(serialized.size() + facesCount + indices.size());
+    for (size_t i = 0; i < facesCount; ++i)
+    {
+        RepoFace face = (*this)[i];
+        serialized.push_back(face.mNumIndices);
+        serialized.insert(serialized.end(),
+                          face.mIndices, face.mIndices + face.mNumIndices);
+    }
+}
+
+bool repo::core::RepoFaceBuffer::assignTriangles(
+        const char *data,
+        size_t trianglesCount,
+        unsigned int indexSize)
+{
+    clear();
+    bool success = true;
+    if (sizeof(uint32_t) == indexSize)
+    {
+        indices.resize(trianglesCount * 3);
+        if (!indices.empty())
+            memcpy(&indices[0], data, indices.size() * sizeof(uint32_t));
+    }
+    else if (sizeof(uint16_t) == indexSize)
+    {
+        std::vector<uint16_t> shortIndices(trianglesCount * 3);
+        if (!shortIndices.empty())
+            memcpy(&shortIndices[0], data, shortIndices.size() * sizeof(uint16_t));
+        indices.assign(shortIndices.begin(), shortIndices.end());
+    }
+    else
+        success = false;
+
+    if (success && trianglesCount > 0)
+    {
+        faceSize = 3;
+        facesCount = trianglesCount;
+    }
+    return success;
+}
+
+bool repo::core::RepoFaceBuffer::isShortIndexable() const
+{
+    bool shortIndexable = true;
+    for (size_t i = 0; i < indices.size() && shortIndexable; ++i)
+        shortIndexable = indices[i] <= 0xFFFF;
+    return shortIndexable;
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoFaceBuffer::beginFace(unsigned int count)
+{
+    if (0 == facesCount && offsets.empty())
+        faceSize = count;
+    else if (offsets.empty() && count != faceSize)
+    {
+        // Faces are about to differ in size, record starts of those so far
+        offsets.reserve(facesCount + 2);
+        for (size_t i = 0; i <= facesCount; ++i)
+            offsets.push_back((uint32_t) (i * faceSize));
+        faceSize = 0;
+    }
+}
+
+void repo::core::RepoFaceBuffer::endFace()
+{
+    if (!offsets.empty())
+        offsets.push_back((uint32_t) indices.size());
+    ++facesCount;
+}
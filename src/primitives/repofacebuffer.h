@@ -0,0 +1,200 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_FACE_BUFFER_H
+#define REPO_FACE_BUFFER_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+//------------------------------------------------------------------------------
+#include "assimp/scene.h"
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+
+namespace repo {
+namespace core {
+
+//! Read-only face of a RepoFaceBuffer, member names follow aiFace.
+struct RepoFace
+{
+    //! Number of indices of the face.
+    unsigned int mNumIndices;
+
+    //! Indices into the vertex array, owned by the buffer.
+    const uint32_t *mIndices;
+};
+
+//------------------------------------------------------------------------------
+/*!
+ * Faces stored as a single contiguous array of vertex indices. As long as all
+ * faces have the same number of indices, eg in triangulated meshes, the start
+ * of each face is computed from its index. Once a face of a different size is
+ * added, an offsets array with the start of every face is kept alongside.
+ * aiFaces, each owning its own index allocation, are only created on export.
+ */
+class REPO_CORE_EXPORT RepoFaceBuffer
+{
+
+public:
+
+    //! Empty buffer.
+    RepoFaceBuffer() : faceSize(0), facesCount(0) {}
+
+    //! Copies faces of an Assimp mesh.
+    RepoFaceBuffer(const aiFace *faces, unsigned int count);
+
+    //--------------------------------------------------------------------------
+
+    //! Appends a face with given indices.
+    void push_back(const uint32_t *indices, unsigned int count);
+
+    //! Appends a copy of an Assimp face.
+    void push_back(const aiFace &face)
+    { push_back(face.mIndices, face.mNumIndices); }
+
+    //! Reserves space for given total number of indices.
+    void reserve(size_t indices) { this->indices.reserve(indices); }
+
+    //! Removes all faces.
+    void clear();
+
+    //--------------------------------------------------------------------------
+
+    //! Returns the number of faces.
+    size_t size() const { return facesCount; }
+
+    //! Returns true if there are no faces.
+    bool empty() const { return 0 == facesCount; }
+
+    //! Returns the face at given index without bounds checking.
+    RepoFace operator[](size_t face) const
+    {
+        RepoFace f;
+        f.mNumIndices = getNumIndices(face);
+        f.mIndices = indices.data() + getOffset(face);
+        return f;
+    }
+
+    //! Returns the face at given index, throws std::out_of_range if invalid.
+    RepoFace at(size_t face) const;
+
+    //! Returns the number of indices of given face.
+    unsigned int getNumIndices(size_t face) const
+    {
+        return offsets.empty()
+                ? faceSize
+                : offsets[face + 1] - offsets[face];
+    }
+
+    //! Returns the position of the first index of given face.
+    size_t getOffset(size_t face) const
+    { return offsets.empty() ? face * faceSize : offsets[face]; }
+
+    /*!
+     * Returns the number of indices shared by all faces, 0 if the faces
+     * differ in size or there are none.
+     */
+    unsigned int getFaceSize() const { return offsets.empty() ? faceSize : 0; }
+
+    //! Returns true if all faces are triangles.
+    bool isTriangles() const { return 3 == getFaceSize(); }
+
+    //! Returns all indices of all faces one after another.
+    const std::vector<uint32_t> &getIndices() const { return indices; }
+
+    /*!
+     * Returns the starts of all faces followed by the total number of indices
+     * if faces differ in size, empty otherwise.
+     */
+    const std::vector<uint32_t> &getOffsets() const { return offsets; }
+
+    //! Returns an Assimp primitive type bit mask of the faces present.
+    unsigned int getPrimitiveTypes() const;
+
+    //--------------------------------------------------------------------------
+    //
+    // Conversion
+    //
+    //--------------------------------------------------------------------------
+
+    /*!
+     * Returns a newly allocated array of aiFaces, each with its own copy of
+     * the indices as Assimp expects to delete them.
+     */
+    aiFace *toAssimp() const;
+
+    /*!
+     * Appends faces serialized as [n1, v1, v2, ..., n2, v1, v2...] where 'n'
+     * is the number of indices 'v' of a single face. Reads at most count
+     * faces and stops early if the data is truncated. The data does not need
+     * to be aligned. Returns the number of faces read.
+     */
+    size_t appendSerialized(const char *data, size_t bytes, size_t count);
+
+    //! Serializes faces as [n1, v1, v2, ..., n2, v1, v2...].
+    void toSerialized(std::vector<uint32_t> &serialized) const;
+
+    /*!
+     * Replaces all faces with triangles given as consecutive triples of
+     * indices of indexSize bytes each, either 2 or 4. The data does not need
+     * to be aligned. 32-bit indices are copied in a single memcpy. Returns
+     * false and leaves the buffer empty if the index size is not supported.
+     */
+    bool assignTriangles(
+            const char *data,
+            size_t trianglesCount,
+            unsigned int indexSize);
+
+    //! Returns true if all indices are below 2^16, ie fit 16-bit storage.
+    bool isShortIndexable() const;
+
+    bool operator==(const RepoFaceBuffer &other) const
+    {
+        return facesCount == other.facesCount &&
+                getFaceSize() == other.getFaceSize() &&
+                indices == other.indices &&
+                offsets == other.offsets;
+    }
+
+private:
+
+    //! Updates face sizes before a face of given size is appended.
+    void beginFace(unsigned int count);
+
+    //! Records the end of the face just appended.
+    void endFace();
+
+private:
+
+    //! Indices of all faces.
+    std::vector<uint32_t> indices;
+
+    //! Start of each face plus the end, empty while all faces are the same size.
+    std::vector<uint32_t> offsets;
+
+    //! Number of indices per face while offsets are empty.
+    unsigned int faceSize;
+
+    size_t facesCount;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_FACE_BUFFER_H
@@ -0,0 +1,93 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repothreadpool.h"
+
+#include <algorithm>
+
+unsigned int repo::core::RepoThreadPool::getDefaultSize()
+{
+    unsigned int size = std::thread::hardware_concurrency();
+    return size > 0 ? size : 4;
+}
+
+repo::core::RepoThreadPool::RepoThreadPool(unsigned int size)
+    : busy(0)
+    , stopping(false)
+{
+    for (unsigned int i = 0; i < std::max(1u, size); ++i)
+        threads.push_back(std::thread(&RepoThreadPool::run, this));
+}
+
+repo::core::RepoThreadPool::~RepoThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskQueued.notify_all();
+    for (unsigned int i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
+
+void repo::core::RepoThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!tasks.empty() || busy > 0)
+        taskFinished.wait(lock);
+}
+
+//------------------------------------------------------------------------------
+//
+// Private
+//
+//------------------------------------------------------------------------------
+
+void repo::core::RepoThreadPool::enqueue(const std::function<void()> &task)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    taskQueued.notify_one();
+}
+
+void repo::core::RepoThreadPool::run()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (tasks.empty() && !stopping)
+                taskQueued.wait(lock);
+            if (tasks.empty())
+                return; // stopping and nothing left to do
+            task = tasks.front();
+            tasks.pop_front();
+            ++busy;
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            --busy;
+        }
+        taskFinished.notify_all();
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_THREAD_POOL_H
+#define REPO_THREAD_POOL_H
+
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+//------------------------------------------------------------------------------
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace repo {
+namespace core {
+
+//------------------------------------------------------------------------------
+/*!
+ * Fixed size pool of worker threads executing submitted tasks in FIFO order.
+ * Destructor waits for all queued tasks to finish before joining the threads.
+ */
+class REPO_CORE_EXPORT RepoThreadPool
+{
+
+public:
+
+    //! Returns the number of hardware threads, or 4 if it cannot be detected.
+    static unsigned int getDefaultSize();
+
+    //! Starts given number of worker threads.
+    RepoThreadPool(unsigned int size = getDefaultSize());
+
+    //! Waits for all queued tasks to finish and joins the worker threads.
+    ~RepoThreadPool();
+
+    /*!
+     * Queues a task for execution and returns a future holding its result.
+     * Exceptions thrown by the task are rethrown by future::get().
+     */
+    template <typename Function>
+    std::future<typename std::result_of<Function()>::type> submit(
+            Function task)
+    {
+        typedef typename std::result_of<Function()>::type ResultType;
+        std::shared_ptr<std::packaged_task<ResultType()> > packagedTask(
+                    new std::packaged_task<ResultType()>(task));
+        std::future<ResultType> future = packagedTask->get_future();
+        enqueue([packagedTask]() { (*packagedTask)(); });
+        return future;
+    }
+
+    //! Blocks until the queue is empty and all worker threads are idle.
+    void wait();
+
+    //! Returns the number of worker threads.
+    unsigned int size() const { return (unsigned int) threads.size(); }
+
+private:
+
+    RepoThreadPool(const RepoThreadPool &);
+
+    RepoThreadPool &operator=(const RepoThreadPool &);
+
+    //! Appends a task to the queue and wakes up a worker.
+    void enqueue(const std::function<void()> &task);
+
+    //! Worker thread loop.
+    void run();
+
+private:
+
+    std::vector<std::thread> threads;
+
+    std::deque<std::function<void()> > tasks;
+
+    std::mutex mutex;
+
+    //! Signalled when a task is queued or the pool is stopping.
+    std::condition_variable taskQueued;
+
+    //! Signalled when a worker finishes a task.
+    std::condition_variable taskFinished;
+
+    //! Number of tasks currently being executed.
+    unsigned int busy;
+
+    bool stopping;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_THREAD_POOL_H
@@ -0,0 +1,111 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repovertexattributes.h"
+
+//------------------------------------------------------------------------------
+
+repo::core::RepoVertexAttributes::RepoVertexAttributes()
+    : attributes(0)
+    , layout(STRUCTURE_OF_ARRAYS)
+    , verticesCount(0)
+    , stride(1)
+    , componentStride(0)
+{
+    std::fill(offsets, offsets + ATTRIBUTES_COUNT, 0);
+}
+
+repo::core::RepoVertexAttributes::RepoVertexAttributes(
+        size_t verticesCount,
+        unsigned int attributes,
+        Layout layout)
+    : attributes(attributes & ((1u << ATTRIBUTES_COUNT) - 1))
+    , layout(layout)
+    , verticesCount(verticesCount)
+{
+    const size_t floatsPerLine = ALIGNMENT / sizeof(float);
+
+    size_t position = 0;
+    for (unsigned int a = 0; a < ATTRIBUTES_COUNT; ++a)
+    {
+        offsets[a] = position;
+        if (has((Attribute) a))
+            position += getComponentsCount((Attribute) a);
+    }
+
+    if (STRUCTURE_OF_ARRAYS == layout)
+    {
+        // Every component array is padded to whole cache lines
+        stride = 1;
+        componentStride =
+                (verticesCount + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+        for (unsigned int a = 0; a < ATTRIBUTES_COUNT; ++a)
+            offsets[a] *= componentStride;
+        data.resize(position * componentStride, 0.0f);
+    }
+    else
+    {
+        // Vertex records are padded to 16 bytes
+        stride = (position + 3) / 4 * 4;
+        componentStride = 1;
+        data.resize(stride * verticesCount, 0.0f);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+unsigned int repo::core::RepoVertexAttributes::getComponentsCount(
+        Attribute attribute)
+{
+    unsigned int count = 0;
+    switch (attribute)
+    {
+    case POSITION :
+    case NORMAL :
+        count = 3;
+        break;
+    case COLOR :
+        count = 4;
+        break;
+    default :
+        count = attribute < ATTRIBUTES_COUNT ? 2 : 0;
+    }
+    return count;
+}
+
+bool repo::core::RepoVertexAttributes::getMinMax(
+        Attribute attribute,
+        float *min,
+        float *max) const
+{
+    bool success = has(attribute) && verticesCount > 0;
+    for (unsigned int c = 0; success && c < getComponentsCount(attribute); ++c)
+    {
+        const float *values = getComponent(attribute, c);
+        float lowest = values[0];
+        float highest = values[0];
+        for (size_t i = 1; i < verticesCount; ++i)
+        {
+            float value = values[i * stride];
+            lowest = value < lowest ? value : lowest;
+            highest = value > highest ? value : highest;
+        }
+        min[c] = lowest;
+        max[c] = highest;
+    }
+    return success;
+}
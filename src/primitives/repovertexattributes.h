@@ -0,0 +1,184 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_VERTEX_ATTRIBUTES_H
+#define REPO_VERTEX_ATTRIBUTES_H
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+//------------------------------------------------------------------------------
+#include "assimp/scene.h"
+//------------------------------------------------------------------------------
+#include "../repocoreglobal.h"
+#include "repoalignedallocator.h"
+#include "repobinaryview.h"
+
+namespace repo {
+namespace core {
+
+//------------------------------------------------------------------------------
+/*!
+ * Per-vertex float attributes of a mesh in a single cache line aligned buffer,
+ * laid out to suit a particular use.
+ *
+ * In STRUCTURE_OF_ARRAYS layout every component, eg all x coordinates of the
+ * positions, is a contiguous array starting on a 64-byte boundary, suitable
+ * for vectorized loops over a single component. In INTERLEAVED layout all
+ * attributes of a vertex are stored together in a record padded to 16 bytes,
+ * suitable for gathering whole vertices in index order.
+ *
+ * Either way, component c of vertex i of attribute a is found at
+ * getComponent(a, c)[i * getStride()], so the same loop serves both layouts.
+ * Attributes keep their real dimensionality, UVs have two components.
+ */
+class REPO_CORE_EXPORT RepoVertexAttributes
+{
+
+public:
+
+    enum Layout { STRUCTURE_OF_ARRAYS, INTERLEAVED };
+
+    //! Attributes, UV channels follow UV_CHANNEL_0 consecutively.
+    enum Attribute {
+        POSITION = 0,
+        NORMAL,
+        COLOR,
+        UV_CHANNEL_0,
+        ATTRIBUTES_COUNT = UV_CHANNEL_0 + AI_MAX_NUMBER_OF_TEXTURECOORDS
+    };
+
+    //! Alignment of the buffer and of SoA component arrays in bytes.
+    static const size_t ALIGNMENT = 64;
+
+public:
+
+    //! Empty attributes.
+    RepoVertexAttributes();
+
+    /*!
+     * Zero initialized attributes of given vertices count. The attributes are
+     * a bit mask of getMask() values.
+     */
+    RepoVertexAttributes(
+            size_t verticesCount,
+            unsigned int attributes,
+            Layout layout = STRUCTURE_OF_ARRAYS);
+
+    //--------------------------------------------------------------------------
+
+    //! Returns the bit mask of a single attribute.
+    static unsigned int getMask(Attribute attribute)
+    { return 1u << attribute; }
+
+    //! Returns the attribute of given UV channel.
+    static Attribute getUVChannel(unsigned int channel)
+    { return (Attribute) (UV_CHANNEL_0 + channel); }
+
+    //! Returns the number of float components of an attribute.
+    static unsigned int getComponentsCount(Attribute attribute);
+
+    //--------------------------------------------------------------------------
+
+    //! Returns true if the attribute is present.
+    bool has(Attribute attribute) const
+    { return 0 != (attributes & getMask(attribute)); }
+
+    //! Returns the bit mask of present attributes.
+    unsigned int getAttributes() const { return attributes; }
+
+    Layout getLayout() const { return layout; }
+
+    //! Returns the number of vertices.
+    size_t size() const { return verticesCount; }
+
+    bool empty() const { return 0 == verticesCount; }
+
+    //! Returns the number of floats in between consecutive vertices.
+    size_t getStride() const { return stride; }
+
+    /*!
+     * Returns the given component of the attribute of the very first vertex,
+     * NULL if the attribute is not present.
+     */
+    float *getComponent(Attribute attribute, unsigned int component)
+    {
+        return has(attribute)
+                ? data.data() + offsets[attribute] + component * componentStride
+                : NULL;
+    }
+
+    const float *getComponent(Attribute attribute, unsigned int component) const
+    { return const_cast<RepoVertexAttributes *>(this)->getComponent(attribute, component); }
+
+    //--------------------------------------------------------------------------
+
+    /*!
+     * Copies up to size() values of a tightly packed float vector type such as
+     * aiVector3D or aiColor4D into the attribute. Missing components are left
+     * zero, extra ones are ignored. The values do not need to be aligned.
+     */
+    template <class V>
+    void assign(Attribute attribute, const RepoBinaryView<V> &values)
+    {
+        unsigned int components = std::min<size_t>(
+                    getComponentsCount(attribute), sizeof(V) / sizeof(float));
+        size_t count = std::min(values.size(), verticesCount);
+        for (unsigned int c = 0; has(attribute) && c < components; ++c)
+        {
+            float *destination = getComponent(attribute, c);
+            const char *source = values.bytes() + c * sizeof(float);
+            for (size_t i = 0; i < count; ++i, source += sizeof(V))
+                memcpy(destination + i * stride, source, sizeof(float));
+        }
+    }
+
+    /*!
+     * Returns per component min and max values of the attribute, which have
+     * to hold getComponentsCount() floats each. Returns false if the
+     * attribute is not present or there are no vertices.
+     */
+    bool getMinMax(Attribute attribute, float *min, float *max) const;
+
+private:
+
+    //! Contiguous storage of all attributes.
+    std::vector<float, RepoAlignedAllocator<float, ALIGNMENT> > data;
+
+    //! Start of each present attribute in floats.
+    size_t offsets[ATTRIBUTES_COUNT];
+
+    //! Bit mask of present attributes.
+    unsigned int attributes;
+
+    Layout layout;
+
+    size_t verticesCount;
+
+    //! Floats in between consecutive vertices.
+    size_t stride;
+
+    //! Floats in between consecutive components of an attribute.
+    size_t componentStride;
+
+}; // end class
+
+} // end namespace core
+} // end namespace repo
+
+#endif // REPO_VERTEX_ATTRIBUTES_H
@@ -0,0 +1,135 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Serialization benchmark of the precomputed BSON array index keys, takes
+// an optional number of transformations, 100000 by default.
+
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+//------------------------------------------------------------------------------
+#include <boost/lexical_cast.hpp>
+//------------------------------------------------------------------------------
+#include "graph/repo_node_transformation.h"
+#include "conversion/repo_transcoder_bson.h"
+#include "conversion/repo_transcoder_string.h"
+
+// Array encoding as done before the precomputed index keys, ie a temporary
+// string per element, kept here as the baseline.
+template <class T>
+static void appendLegacy(const std::string &label, const std::vector<T> &vec, mongo::BSONObjBuilder &builder)
+{
+	mongo::BSONObjBuilder array;
+	for (unsigned int i = 0; i < vec.size(); ++i)
+		repo::core::RepoTranscoderBSON::append(boost::lexical_cast<std::string>(i), vec[i], array);
+	builder.appendArray(label, array.obj());
+}
+
+template <class T>
+static void appendLegacy(const std::string &label, const std::vector<std::vector<T> > &vec, mongo::BSONObjBuilder &builder)
+{
+	mongo::BSONObjBuilder array;
+	for (unsigned int i = 0; i < vec.size(); ++i)
+		appendLegacy(boost::lexical_cast<std::string>(i), vec[i], array);
+	builder.appendArray(label, array.obj());
+}
+
+// Mirrors RepoNodeTransformation::toBSONObj() using the legacy array encoding.
+static mongo::BSONObj toBSONObjLegacy(const repo::core::RepoNodeTransformation *node)
+{
+	mongo::BSONObjBuilder builder;
+	repo::core::RepoTranscoderBSON::append(REPO_NODE_LABEL_ID, node->getUniqueID(), builder);
+	repo::core::RepoTranscoderBSON::append(REPO_NODE_LABEL_SHARED_ID, node->getSharedID(), builder);
+	std::vector<std::vector<boost::uuids::uuid> > paths = repo::core::RepoNodeAbstract::getPaths(node);
+	if (paths.size() > 0)
+		appendLegacy(REPO_NODE_LABEL_PATHS, paths, builder);
+	builder << REPO_NODE_LABEL_TYPE << node->getType();
+	builder << REPO_NODE_LABEL_API << REPO_NODE_API_LEVEL_1;
+	if (!node->isRoot())
+	{
+		std::vector<boost::uuids::uuid> parents;
+		std::set<const repo::core::RepoNodeAbstract *> nodes = node->getParents();
+		for (std::set<const repo::core::RepoNodeAbstract *>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+			parents.push_back((*it)->getSharedID());
+		appendLegacy(REPO_NODE_LABEL_PARENTS, parents, builder);
+	}
+	if (!node->getName().empty())
+		builder << REPO_NODE_LABEL_NAME << node->getName();
+
+	aiMatrix4x4 matrix = node->getMatrix();
+	mongo::BSONObjBuilder rows;
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		mongo::BSONObjBuilder columns;
+		for (unsigned int j = 0; j < 4; ++j)
+			columns << repo::core::RepoTranscoderString::toString(j) << matrix[i][j];
+		rows.appendArray(repo::core::RepoTranscoderString::toString(i), columns.obj());
+	}
+	builder.appendArray(REPO_NODE_LABEL_MATRIX, rows.obj());
+	return builder.obj();
+}
+
+// Compares toBSONObj() throughput against the legacy encoding on a synthetic
+// scene of given number of transformations, eight children per node.
+static int benchmarkSerialization(unsigned int count)
+{
+	std::vector<repo::core::RepoNodeTransformation *> nodes;
+	nodes.reserve(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		repo::core::RepoNodeTransformation *node =
+			new repo::core::RepoNodeTransformation(repo::core::RepoTranscoderString::toString(i));
+		// Same documents as the legacy encoding, only the array keys differ
+		node->setMatrixEncoding(repo::core::RepoNodeTransformation::ARRAY);
+		if (i > 0)
+		{
+			node->addParent(nodes[(i - 1) / 8]);
+			nodes[(i - 1) / 8]->addChild(node);
+		}
+		nodes.push_back(node);
+	}
+
+	size_t legacyBytes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < count; ++i)
+		legacyBytes += toBSONObjLegacy(nodes[i]).objsize();
+	std::chrono::duration<double> legacy = std::chrono::steady_clock::now() - start;
+
+	size_t bytes = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < count; ++i)
+		bytes += nodes[i]->toBSONObj().objsize();
+	std::chrono::duration<double> current = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Legacy:      " << legacy.count() << " s, "
+		<< (count / legacy.count()) << " nodes/s, " << legacyBytes << " bytes" << std::endl;
+	std::cout << "toBSONObj(): " << current.count() << " s, "
+		<< (count / current.count()) << " nodes/s, " << bytes << " bytes" << std::endl;
+	std::cout << "Speedup:     " << (legacy.count() / current.count()) << "x" << std::endl;
+
+	for (unsigned int i = 0; i < count; ++i)
+		delete nodes[i];
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	return benchmarkSerialization(argc > 1 ? atoi(argv[1]) : 100000);
+}
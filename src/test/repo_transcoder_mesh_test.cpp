@@ -0,0 +1,287 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Round trip tests of the API level 3 mesh encodings. Returns the number of
+// failed checks, hence 0 on success.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+//------------------------------------------------------------------------------
+#include "conversion/repo_transcoder_mesh.h"
+
+using repo::core::RepoTranscoderMesh;
+
+static int failures = 0;
+
+#define REPO_CHECK(condition) \
+    if (!(condition)) \
+    { \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": " #condition << std::endl; \
+        ++failures; \
+    }
+
+//------------------------------------------------------------------------------
+// LZ
+
+static void checkLZRoundTrip(const std::vector<uint8_t> &data)
+{
+    std::vector<uint8_t> packed = RepoTranscoderMesh::compress(
+                data.empty() ? NULL : &data[0], data.size());
+    std::vector<uint8_t> unpacked;
+    REPO_CHECK(RepoTranscoderMesh::decompress(
+                   &packed[0], packed.size(), data.size(), unpacked));
+    REPO_CHECK(unpacked == data);
+}
+
+static void testLZ()
+{
+    std::vector<uint8_t> data;
+    checkLZRoundTrip(data);
+
+    data.assign(3, 7);
+    checkLZRoundTrip(data);
+
+    // Long runs and overlapping matches
+    data.assign(100000, 42);
+    checkLZRoundTrip(data);
+
+    // Incompressible
+    srand(1);
+    data.resize(70000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (uint8_t) rand();
+    checkLZRoundTrip(data);
+
+    // Repeated blocks beyond the length nibble and offsets far apart
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (uint8_t) ((i % 1000) * 7 + (i / 20000));
+    checkLZRoundTrip(data);
+
+    // Sizes claimed beyond the expected one are refused before allocating
+    std::vector<uint8_t> packed =
+            RepoTranscoderMesh::compress(&data[0], data.size());
+    std::vector<uint8_t> unpacked;
+    REPO_CHECK(!RepoTranscoderMesh::decompress(
+                   &packed[0], packed.size(), data.size() - 1, unpacked));
+    REPO_CHECK(unpacked.empty());
+
+    uint32_t hostile = 0xFFFFFFFFu;
+    memcpy(&packed[0], &hostile, sizeof(hostile));
+    REPO_CHECK(!RepoTranscoderMesh::decompress(
+                   &packed[0], packed.size(), data.size(), unpacked));
+
+    // Truncated input
+    packed = RepoTranscoderMesh::compress(&data[0], data.size());
+    REPO_CHECK(!RepoTranscoderMesh::decompress(
+                   &packed[0], packed.size() / 2, data.size(), unpacked));
+    REPO_CHECK(unpacked.empty());
+}
+
+//------------------------------------------------------------------------------
+// Tipsify
+
+//! Rotates the triangle to start with its smallest index, keeping winding.
+static std::vector<uint32_t> canonicalTriangles(const std::vector<uint32_t> &indices)
+{
+    std::vector<std::vector<uint32_t> > triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        std::vector<uint32_t> triangle(indices.begin() + i, indices.begin() + i + 3);
+        std::rotate(triangle.begin(),
+                    std::min_element(triangle.begin(), triangle.end()),
+                    triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    std::vector<uint32_t> flat;
+    for (size_t i = 0; i < triangles.size(); ++i)
+        flat.insert(flat.end(), triangles[i].begin(), triangles[i].end());
+    return flat;
+}
+
+static void testTipsify()
+{
+    // Regular grid of quads
+    const uint32_t side = 40;
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y + 1 < side; ++y)
+        for (uint32_t x = 0; x + 1 < side; ++x)
+        {
+            uint32_t i = y * side + x;
+            uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side + 1, i + side };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+
+    // Shuffled triangles including a duplicate and a degenerate one
+    srand(2);
+    for (size_t i = indices.size() / 3 - 1; i > 0; --i)
+    {
+        size_t j = rand() % (i + 1);
+        std::swap_ranges(indices.begin() + 3 * i,
+                         indices.begin() + 3 * i + 3,
+                         indices.begin() + 3 * j);
+    }
+    indices.insert(indices.end(), indices.begin(), indices.begin() + 3);
+    uint32_t degenerate[3] = { 5, 5, 6 };
+    indices.insert(indices.end(), degenerate, degenerate + 3);
+
+    std::vector<uint32_t> optimized = RepoTranscoderMesh::optimizeVertexCache(
+                indices, side * side);
+    REPO_CHECK(optimized.size() == indices.size());
+    REPO_CHECK(canonicalTriangles(optimized) == canonicalTriangles(indices));
+
+    std::vector<uint32_t> empty;
+    REPO_CHECK(RepoTranscoderMesh::optimizeVertexCache(empty, 0).empty());
+}
+
+//------------------------------------------------------------------------------
+// Octahedron normals
+
+static void testOct()
+{
+    srand(3);
+    std::vector<aiVector3D> normals;
+    normals.push_back(aiVector3D(1, 0, 0));
+    normals.push_back(aiVector3D(0, -1, 0));
+    normals.push_back(aiVector3D(0, 0, 1));
+    normals.push_back(aiVector3D(0, 0, -1));
+    for (unsigned int i = 0; i < 10000; ++i)
+    {
+        aiVector3D n(rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f);
+        if (n.Length() > 0.01f)
+            normals.push_back(n.Normalize());
+    }
+
+    std::vector<int16_t> encoded = RepoTranscoderMesh::encodeNormals(
+                repo::core::RepoBinaryView<aiVector3D>(&normals));
+    REPO_CHECK(encoded.size() == normals.size() * 2);
+
+    std::vector<aiVector3D> decoded;
+    RepoTranscoderMesh::decodeNormals(&encoded[0], normals.size(), decoded);
+    REPO_CHECK(decoded.size() == normals.size());
+
+    float maxError = 0;
+    for (size_t i = 0; i < decoded.size(); ++i)
+    {
+        maxError = std::max(maxError, (decoded[i] - normals[i]).Length());
+        REPO_CHECK(std::fabs(decoded[i].Length() - 1) < 1e-4f);
+    }
+    REPO_CHECK(maxError < 1e-3f);
+}
+
+//------------------------------------------------------------------------------
+// Tangent frames, both handednesses
+
+static void testTangents()
+{
+    std::vector<aiVector3D> normals, tangents, bitangents;
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        aiVector3D n(rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f);
+        aiVector3D a(rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f,
+                     rand() / (float) RAND_MAX - 0.5f);
+        aiVector3D t = n ^ a;
+        if (n.Length() < 0.01f || t.Length() < 0.01f)
+            continue;
+        n.Normalize();
+        t.Normalize();
+        aiVector3D b = n ^ t;
+        normals.push_back(n);
+        tangents.push_back(t);
+        bitangents.push_back(i % 2 ? b : b * -1.0f);
+    }
+
+    std::vector<int16_t> encoded = RepoTranscoderMesh::encodeTangents(
+                repo::core::RepoBinaryView<aiVector3D>(&normals),
+                repo::core::RepoBinaryView<aiVector3D>(&tangents),
+                repo::core::RepoBinaryView<aiVector3D>(&bitangents));
+    REPO_CHECK(encoded.size() == tangents.size() * 3);
+
+    std::vector<aiVector3D> decodedTangents, decodedBitangents;
+    RepoTranscoderMesh::decodeTangents(
+                &encoded[0],
+                tangents.size(),
+                repo::core::RepoBinaryView<aiVector3D>(&normals),
+                decodedTangents,
+                decodedBitangents);
+    REPO_CHECK(decodedTangents.size() == tangents.size());
+    REPO_CHECK(decodedBitangents.size() == bitangents.size());
+
+    float maxError = 0;
+    for (size_t i = 0; i < decodedTangents.size(); ++i)
+    {
+        maxError = std::max(maxError,
+                            (decodedTangents[i] - tangents[i]).Length());
+        maxError = std::max(maxError,
+                            (decodedBitangents[i] - bitangents[i]).Length());
+    }
+    REPO_CHECK(maxError < 1e-3f);
+}
+
+//------------------------------------------------------------------------------
+// Zigzag deltas
+
+static void testZigzag()
+{
+    std::vector<uint32_t> indices;
+    uint32_t values[] = { 0, 1, 0, 2, 0xFFFFFFFFu, 0, 0x80000000u, 0x7FFFFFFFu, 5, 5 };
+    indices.assign(values, values + sizeof(values) / sizeof(values[0]));
+
+    std::vector<uint32_t> encoded = RepoTranscoderMesh::encodeIndices(indices);
+    REPO_CHECK(encoded.size() == indices.size());
+    // Small steps either way map to small values
+    REPO_CHECK(encoded[1] == 2 && encoded[2] == 1);
+
+    std::vector<uint32_t> decoded;
+    RepoTranscoderMesh::decodeIndices(&encoded[0], encoded.size(), decoded);
+    REPO_CHECK(decoded == indices);
+
+    // Through the whole packing pipeline
+    std::vector<uint8_t> packed = RepoTranscoderMesh::pack(encoded);
+    std::vector<uint32_t> unpacked;
+    REPO_CHECK(RepoTranscoderMesh::unpack(
+                   (const char *) &packed[0], packed.size(), encoded.size(), unpacked));
+    REPO_CHECK(unpacked == encoded);
+    REPO_CHECK(!RepoTranscoderMesh::unpack(
+                   (const char *) &packed[0], packed.size(), encoded.size() - 1, unpacked));
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    testLZ();
+    testTipsify();
+    testOct();
+    testTangents();
+    testZigzag();
+
+    if (failures)
+        std::cerr << failures << " checks failed" << std::endl;
+    else
+        std::cout << "All checks passed" << std::endl;
+    return failures;
+}